@@ -40,6 +40,7 @@ ConverterControl::ConverterControl()
 QString ConverterControl::automappingRuleFileVersion(const QString &fileName)
 {
     Tiled::MapReader reader;
+    reader.setTilesetCache(&mTilesetCache);
     Tiled::Map *map = reader.readMap(fileName);
 
     if (!map)
@@ -86,6 +87,7 @@ QString ConverterControl::automappingRuleFileVersion(const QString &fileName)
 void ConverterControl::convertV1toV2(const QString &fileName)
 {
     Tiled::MapReader reader;
+    reader.setTilesetCache(&mTilesetCache);
     Tiled::Map *map = reader.readMap(fileName);
 
     if (!map) {
@@ -114,6 +116,8 @@ void ConverterControl::convertV1toV2(const QString &fileName)
     writer.setLayerDataFormat(map->layerDataFormat());
     writer.writeMap(map, fileName);
 
-    qDeleteAll(map->tilesets());
+    foreach (Tiled::Tileset *tileset, map->tilesets())
+        if (!mTilesetCache.contains(tileset))
+            delete tileset;
     delete map;
 }
@@ -22,6 +22,8 @@
 #ifndef CONVERTERCONTROL_H
 #define CONVERTERCONTROL_H
 
+#include "tilesetcache.h"
+
 #include <QString>
 #include <QObject>
 
@@ -37,6 +39,10 @@ public:
 
     QString automappingRuleFileVersion(const QString &fileName);
     void convertV1toV2(const QString &fileName);
+
+private:
+    // Rule files tend to share their tilesets
+    Tiled::TilesetCache mTilesetCache;
 };
 
 #endif // CONVERTERCONTROL_H
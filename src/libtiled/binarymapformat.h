@@ -0,0 +1,69 @@
+/*
+ * binarymapformat.h
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BINARYMAPFORMAT_H
+#define BINARYMAPFORMAT_H
+
+namespace Tiled {
+namespace Internal {
+
+/**
+ * Constants describing the binary map format shared by BinaryMapReader and
+ * BinaryMapWriter.
+ *
+ * All numbers are stored in little endian byte order. A file starts with the
+ * magic number and the version, followed by a table of UTF-8 encoded strings,
+ * which are referred to by their index everywhere else. Then come the map
+ * attributes, the tilesets and the layers. Tile layers are stored as a list
+ * of zlib compressed chunks of global tile IDs, each prefixed with its
+ * location and compressed length. Chunks without any tiles are left out.
+ */
+namespace BinaryMapFormat {
+
+enum {
+    Magic = 0x31424D54,     // "TMB1"
+    Version = 1,
+    ChunkSize = 64
+};
+
+enum TilesetKind {
+    ExternalTileset,
+    EmbeddedTileset         // Stored as a TSX document
+};
+
+enum LayerKind {
+    TileLayerKind,
+    ObjectGroupKind,
+    ImageLayerKind
+};
+
+} // namespace BinaryMapFormat
+} // namespace Internal
+} // namespace Tiled
+
+#endif // BINARYMAPFORMAT_H
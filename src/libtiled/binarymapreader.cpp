@@ -0,0 +1,621 @@
+/*
+ * binarymapreader.cpp
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "binarymapreader.h"
+
+#include "binarymapformat.h"
+#include "compression.h"
+#include "gidmapper.h"
+#include "imagelayer.h"
+#include "map.h"
+#include "mapobject.h"
+#include "mapreader.h"
+#include "objectgroup.h"
+#include "tilelayer.h"
+#include "tileset.h"
+#include "tilesetcache.h"
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QVector>
+#include <QtEndian>
+
+#include <climits>
+#include <cstring>
+
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+namespace Tiled {
+namespace Internal {
+
+class BinaryMapReaderPrivate
+{
+    Q_DECLARE_TR_FUNCTIONS(BinaryMapReader)
+
+    friend class Tiled::BinaryMapReader;
+
+public:
+    BinaryMapReaderPrivate(BinaryMapReader *mapReader)
+        : p(mapReader)
+        , mData(0)
+        , mEnd(0)
+        , mTilesetCache(0)
+    {}
+
+    Map *readMap(const char *data, int size, const QString &path);
+
+private:
+    Map *readMap();
+    Tileset *readTileset();
+    Layer *readLayer();
+    void readTileLayer(TileLayer *tileLayer);
+    void readObjectGroup(ObjectGroup *objectGroup);
+    void readImageLayer(ImageLayer *imageLayer);
+
+    bool atEnd(int size);
+    quint32 readUInt();
+    qint32 readInt() { return qint32(readUInt()); }
+    double readDouble();
+    QString readString();
+    QColor readColor();
+    const char *readBytes(int *size);
+    Properties readProperties();
+
+    /**
+     * Sets the error message, unless an error was already raised.
+     */
+    void raiseError(const QString &error);
+    bool hasError() const { return !mError.isEmpty(); }
+
+    BinaryMapReader *p;
+
+    QString mError;
+    QString mPath;
+    const uchar *mData;
+    const uchar *mEnd;
+    QStringList mStrings;
+    GidMapper mGidMapper;
+    QList<Tileset*> mCreatedTilesets;
+    TilesetCache *mTilesetCache;
+};
+
+} // namespace Internal
+} // namespace Tiled
+
+
+Map *BinaryMapReaderPrivate::readMap(const char *data, int size,
+                                     const QString &path)
+{
+    using namespace BinaryMapFormat;
+
+    mError.clear();
+    mPath = path;
+    mData = reinterpret_cast<const uchar*>(data);
+    mEnd = mData + size;
+
+    if (readUInt() != Magic) {
+        mError = tr("Not a binary map file.");
+        return 0;
+    }
+
+    const quint32 version = readUInt();
+    if (version != Version) {
+        mError = tr("Unsupported binary map version: %1").arg(version);
+        return 0;
+    }
+
+    const quint32 stringCount = readUInt();
+    for (quint32 i = 0; i < stringCount && !hasError(); ++i) {
+        int length;
+        const char *string = readBytes(&length);
+        mStrings.append(QString::fromUtf8(string, length));
+    }
+
+    Map *map = hasError() ? 0 : readMap();
+
+    mStrings.clear();
+    mGidMapper.clear();
+    mCreatedTilesets.clear();
+    mData = mEnd = 0;
+
+    return map;
+}
+
+Map *BinaryMapReaderPrivate::readMap()
+{
+    const quint32 orientation = readUInt();
+    const int width = readInt();
+    const int height = readInt();
+    const int tileWidth = readInt();
+    const int tileHeight = readInt();
+    const QColor backgroundColor = readColor();
+    const qint32 layerDataFormat = readInt();
+
+    if (hasError())
+        return 0;
+
+    if (orientation == Map::Unknown || orientation > Map::Staggered) {
+        raiseError(tr("Unsupported map orientation: %1").arg(orientation));
+        return 0;
+    }
+
+    if (layerDataFormat < Map::Default || layerDataFormat > Map::CSV) {
+        raiseError(tr("Unsupported layer data format: %1")
+                   .arg(layerDataFormat));
+        return 0;
+    }
+
+    Map *map = new Map(Map::Orientation(orientation),
+                       width, height, tileWidth, tileHeight);
+    map->setBackgroundColor(backgroundColor);
+    map->setLayerDataFormat(Map::LayerDataFormat(layerDataFormat));
+    map->setProperties(readProperties());
+
+    const quint32 tilesetCount = readUInt();
+    for (quint32 i = 0; i < tilesetCount && !hasError(); ++i) {
+        if (Tileset *tileset = readTileset())
+            map->addTileset(tileset);
+    }
+
+    const quint32 layerCount = readUInt();
+    for (quint32 i = 0; i < layerCount && !hasError(); ++i) {
+        if (Layer *layer = readLayer())
+            map->addLayer(layer);
+    }
+
+    // Clean up in case of error
+    if (hasError()) {
+        // The tilesets are not owned by the map
+        qDeleteAll(mCreatedTilesets);
+        delete map;
+        return 0;
+    }
+
+    return map;
+}
+
+Tileset *BinaryMapReaderPrivate::readTileset()
+{
+    using namespace BinaryMapFormat;
+
+    const quint32 kind = readUInt();
+    const quint32 firstGid = readUInt();
+    Tileset *tileset = 0;
+
+    if (kind == ExternalTileset) {
+        const QString source = p->resolveReference(readString(), mPath);
+        if (hasError())
+            return 0;
+
+        QString error;
+        tileset = p->readExternalTileset(source, &error);
+
+        if (!tileset) {
+            raiseError(tr("Error while loading tileset '%1': %2")
+                       .arg(source, error));
+        }
+    } else if (kind == EmbeddedTileset) {
+        int size;
+        const char *data = readBytes(&size);
+        if (hasError())
+            return 0;
+
+        QByteArray tsx = QByteArray::fromRawData(data, size);
+        QBuffer buffer(&tsx);
+        buffer.open(QIODevice::ReadOnly);
+
+        MapReader reader;
+        tileset = reader.readTileset(&buffer, mPath);
+
+        if (tileset)
+            mCreatedTilesets.append(tileset);
+        else
+            raiseError(reader.errorString());
+    } else {
+        raiseError(tr("Unknown tileset kind: %1").arg(kind));
+    }
+
+    if (tileset) {
+        if (firstGid == 0)
+            raiseError(tr("Invalid first global tile ID for tileset '%1'")
+                       .arg(tileset->name()));
+        else
+            mGidMapper.insert(firstGid, tileset);
+    }
+
+    return tileset;
+}
+
+Layer *BinaryMapReaderPrivate::readLayer()
+{
+    using namespace BinaryMapFormat;
+
+    const quint32 kind = readUInt();
+    const QString name = readString();
+    const int x = readInt();
+    const int y = readInt();
+    const int width = readInt();
+    const int height = readInt();
+    const double opacity = readDouble();
+    const bool visible = readUInt();
+    const Properties properties = readProperties();
+
+    if (hasError())
+        return 0;
+
+    if (width < 0 || height < 0) {
+        raiseError(tr("Invalid size for layer '%1'").arg(name));
+        return 0;
+    }
+
+    Layer *layer = 0;
+
+    switch (kind) {
+    case TileLayerKind: {
+        TileLayer *tileLayer = new TileLayer(name, x, y, width, height);
+        layer = tileLayer;
+        readTileLayer(tileLayer);
+        break;
+    }
+    case ObjectGroupKind: {
+        ObjectGroup *objectGroup = new ObjectGroup(name, x, y, width, height);
+        layer = objectGroup;
+        readObjectGroup(objectGroup);
+        break;
+    }
+    case ImageLayerKind: {
+        ImageLayer *imageLayer = new ImageLayer(name, x, y, width, height);
+        layer = imageLayer;
+        readImageLayer(imageLayer);
+        break;
+    }
+    default:
+        raiseError(tr("Unknown layer kind: %1").arg(kind));
+        return 0;
+    }
+
+    if (hasError()) {
+        delete layer;
+        return 0;
+    }
+
+    layer->setOpacity(opacity);
+    layer->setVisible(visible);
+    layer->setProperties(properties);
+
+    return layer;
+}
+
+void BinaryMapReaderPrivate::readTileLayer(TileLayer *tileLayer)
+{
+    const quint32 chunkCount = readUInt();
+
+    QVector<unsigned> gids;
+    QVector<Cell> cells;
+
+    for (quint32 i = 0; i < chunkCount && !hasError(); ++i) {
+        const int chunkX = readInt();
+        const int chunkY = readInt();
+        const int chunkWidth = readInt();
+        const int chunkHeight = readInt();
+        int size;
+        const char *data = readBytes(&size);
+
+        if (hasError())
+            return;
+
+        if (chunkX < 0 || chunkY < 0 || chunkWidth <= 0 || chunkHeight <= 0
+                || chunkWidth > tileLayer->width() - chunkX
+                || chunkHeight > tileLayer->height() - chunkY) {
+            raiseError(tr("Corrupt layer data for layer '%1'")
+                       .arg(tileLayer->name()));
+            return;
+        }
+
+        const int expectedSize = chunkWidth * chunkHeight * 4;
+        const QByteArray compressed = QByteArray::fromRawData(data, size);
+        const QByteArray chunk = decompress(compressed, expectedSize);
+
+        if (chunk.size() != expectedSize) {
+            raiseError(tr("Corrupt layer data for layer '%1'")
+                       .arg(tileLayer->name()));
+            return;
+        }
+
+        gids.resize(chunkWidth);
+        cells.resize(chunkWidth);
+        const uchar *in = reinterpret_cast<const uchar*>(chunk.constData());
+
+        for (int y = chunkY; y < chunkY + chunkHeight; ++y) {
+            for (int x = 0; x < chunkWidth; ++x, in += 4)
+                gids[x] = qFromLittleEndian<quint32>(in);
+
+            const int invalidIndex = mGidMapper.gidsToCells(gids.constData(),
+                                                            chunkWidth,
+                                                            cells.data());
+            if (invalidIndex != -1) {
+                if (mGidMapper.isEmpty())
+                    raiseError(tr("Tile used but no tilesets specified"));
+                else
+                    raiseError(tr("Invalid tile: %1")
+                               .arg(gids.at(invalidIndex)));
+                return;
+            }
+
+            tileLayer->setCellRange(y * tileLayer->width() + chunkX,
+                                    chunkWidth, cells.constData());
+        }
+    }
+
+}
+
+void BinaryMapReaderPrivate::readObjectGroup(ObjectGroup *objectGroup)
+{
+    objectGroup->setColor(readColor());
+
+    const quint32 objectCount = readUInt();
+    for (quint32 i = 0; i < objectCount && !hasError(); ++i) {
+        const QString name = readString();
+        const QString type = readString();
+        const unsigned gid = readUInt();
+        const double x = readDouble();
+        const double y = readDouble();
+        const double width = readDouble();
+        const double height = readDouble();
+        const double rotation = readDouble();
+        const quint32 shape = readUInt();
+        const bool visible = readUInt();
+
+        QPolygonF polygon;
+        const quint32 pointCount = readUInt();
+        for (quint32 j = 0; j < pointCount && !hasError(); ++j) {
+            const double pointX = readDouble();
+            const double pointY = readDouble();
+            polygon.append(QPointF(pointX, pointY));
+        }
+
+        const Properties properties = readProperties();
+
+        if (hasError())
+            return;
+
+        MapObject *object = new MapObject(name, type, QPointF(x, y),
+                                          QSizeF(width, height));
+        object->setRotation(rotation);
+        object->setVisible(visible);
+        object->setPolygon(polygon);
+        object->setProperties(properties);
+
+        if (shape <= MapObject::Ellipse)
+            object->setShape(MapObject::Shape(shape));
+
+        if (gid) {
+            bool ok;
+            object->setCell(mGidMapper.gidToCell(gid, ok));
+            if (!ok)
+                raiseError(tr("Invalid tile: %1").arg(gid));
+        }
+
+        objectGroup->addObject(object);
+    }
+}
+
+void BinaryMapReaderPrivate::readImageLayer(ImageLayer *imageLayer)
+{
+    const QString source = readString();
+    imageLayer->setTransparentColor(readColor());
+
+    if (hasError() || source.isEmpty())
+        return;
+
+    const QString imageSource = p->resolveReference(source, mPath);
+    if (!imageLayer->loadFromImage(QImage(imageSource), imageSource)) {
+        raiseError(tr("Error loading image layer image:\n'%1'")
+                   .arg(imageSource));
+    }
+}
+
+bool BinaryMapReaderPrivate::atEnd(int size)
+{
+    if (mEnd - mData >= size)
+        return false;
+
+    raiseError(tr("Unexpected end of file."));
+    mData = mEnd;
+    return true;
+}
+
+quint32 BinaryMapReaderPrivate::readUInt()
+{
+    if (atEnd(4))
+        return 0;
+
+    const quint32 value = qFromLittleEndian<quint32>(mData);
+    mData += 4;
+    return value;
+}
+
+double BinaryMapReaderPrivate::readDouble()
+{
+    if (atEnd(8))
+        return 0;
+
+    const quint64 bits = qFromLittleEndian<quint64>(mData);
+    mData += 8;
+
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+QString BinaryMapReaderPrivate::readString()
+{
+    const quint32 index = readUInt();
+    if (index < quint32(mStrings.size()))
+        return mStrings.at(index);
+
+    raiseError(tr("Invalid string reference: %1").arg(index));
+    return QString();
+}
+
+QColor BinaryMapReaderPrivate::readColor()
+{
+    const bool valid = readUInt();
+    const QRgb rgba = readUInt();
+    return valid ? QColor::fromRgba(rgba) : QColor();
+}
+
+const char *BinaryMapReaderPrivate::readBytes(int *size)
+{
+    const quint32 length = readUInt();
+    *size = 0;
+
+    if (length > INT_MAX || atEnd(length))
+        return 0;
+
+    const char *bytes = reinterpret_cast<const char*>(mData);
+    mData += length;
+    *size = length;
+    return bytes;
+}
+
+Properties BinaryMapReaderPrivate::readProperties()
+{
+    Properties properties;
+
+    const quint32 count = readUInt();
+    for (quint32 i = 0; i < count && !hasError(); ++i) {
+        const QString name = readString();
+        properties.insert(name, readString());
+    }
+
+    return properties;
+}
+
+void BinaryMapReaderPrivate::raiseError(const QString &error)
+{
+    if (mError.isEmpty())
+        mError = error;
+}
+
+
+BinaryMapReader::BinaryMapReader()
+    : d(new BinaryMapReaderPrivate(this))
+{
+}
+
+BinaryMapReader::~BinaryMapReader()
+{
+    delete d;
+}
+
+Map *BinaryMapReader::readMap(QIODevice *device, const QString &path)
+{
+    const QByteArray data = device->readAll();
+    return d->readMap(data.constData(), data.size(), path);
+}
+
+Map *BinaryMapReader::readMap(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.exists()) {
+        d->mError = BinaryMapReaderPrivate::tr("File not found: %1")
+                .arg(fileName);
+        return 0;
+    } else if (!file.open(QIODevice::ReadOnly)) {
+        d->mError = BinaryMapReaderPrivate::tr("Unable to read file: %1")
+                .arg(fileName);
+        return 0;
+    }
+
+    const QString path = QFileInfo(fileName).absolutePath();
+
+    const qint64 size = file.size();
+    uchar *mapped = size > 0 && size <= INT_MAX ? file.map(0, size) : 0;
+    if (!mapped)
+        return readMap(&file, path);
+
+    Map *map = d->readMap(reinterpret_cast<const char*>(mapped), int(size),
+                          path);
+    file.unmap(mapped);
+    return map;
+}
+
+QString BinaryMapReader::errorString() const
+{
+    return d->mError;
+}
+
+void BinaryMapReader::setTilesetCache(TilesetCache *cache)
+{
+    d->mTilesetCache = cache;
+}
+
+TilesetCache *BinaryMapReader::tilesetCache() const
+{
+    return d->mTilesetCache;
+}
+
+bool BinaryMapReader::isBinaryMap(const QByteArray &data)
+{
+    return data.size() >= 4
+            && qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(
+                                              data.constData()))
+            == quint32(BinaryMapFormat::Magic);
+}
+
+QString BinaryMapReader::resolveReference(const QString &reference,
+                                          const QString &mapPath)
+{
+    if (QDir::isRelativePath(reference))
+        return mapPath + QLatin1Char('/') + reference;
+    else
+        return reference;
+}
+
+Tileset *BinaryMapReader::readExternalTileset(const QString &source,
+                                              QString *error)
+{
+    if (d->mTilesetCache)
+        return d->mTilesetCache->tileset(source, error);
+
+    MapReader reader;
+
+    Tileset *tileset = reader.readTileset(source);
+    if (!tileset)
+        *error = reader.errorString();
+    else
+        d->mCreatedTilesets.append(tileset);
+
+    return tileset;
+}
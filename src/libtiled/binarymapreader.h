@@ -0,0 +1,127 @@
+/*
+ * binarymapreader.h
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BINARYMAPREADER_H
+#define BINARYMAPREADER_H
+
+#include "tiled_global.h"
+
+#include <QString>
+
+class QIODevice;
+
+namespace Tiled {
+
+class Map;
+class Tileset;
+class TilesetCache;
+
+namespace Internal {
+class BinaryMapReaderPrivate;
+}
+
+/**
+ * A reader for Tiled's binary map format, as written by BinaryMapWriter.
+ *
+ * The file is read from a single memory mapping where possible, and apart
+ * from the tilesets, its contents can be used without any parsing.
+ *
+ * Can be subclassed when special handling of external tilesets is needed.
+ */
+class TILEDSHARED_EXPORT BinaryMapReader
+{
+public:
+    BinaryMapReader();
+    virtual ~BinaryMapReader();
+
+    /**
+     * Reads a binary map from the given \a device. Optionally a \a path can
+     * be given, which will be used to resolve relative references to external
+     * images and tilesets.
+     *
+     * Returns 0 and sets errorString() when reading failed.
+     *
+     * The caller takes ownership over the newly created map.
+     */
+    Map *readMap(QIODevice *device, const QString &path = QString());
+
+    /**
+     * Reads a binary map from the given \a fileName.
+     * \overload
+     */
+    Map *readMap(const QString &fileName);
+
+    /**
+     * Returns the error message for the last occurred error.
+     */
+    QString errorString() const;
+
+    /**
+     * Returns whether the given \a data starts like a binary map.
+     */
+    static bool isBinaryMap(const QByteArray &data);
+
+    /**
+     * Sets the \a cache used by the default implementation of
+     * readExternalTileset(), like MapReader::setTilesetCache(). Tilesets
+     * returned by the cache are owned by it, and are not deleted when reading
+     * a map fails.
+     *
+     * The cache is not owned by the reader. By default no cache is used.
+     */
+    void setTilesetCache(TilesetCache *cache);
+    TilesetCache *tilesetCache() const;
+
+protected:
+    /**
+     * Called for each \a reference to an external file. Should return the path
+     * to be used when loading this file. \a mapPath contains the path to the
+     * map that is currently being loaded.
+     */
+    virtual QString resolveReference(const QString &reference,
+                                     const QString &mapPath);
+
+    /**
+     * Called when an external tileset is encountered while a map is loaded.
+     * The default implementation gets the tileset from the tileset cache when
+     * one is set, and otherwise calls readTileset() on a new MapReader.
+     *
+     * If an error occurred, the \a error parameter should be set to the error
+     * message.
+     */
+    virtual Tileset *readExternalTileset(const QString &source,
+                                         QString *error);
+
+private:
+    friend class Internal::BinaryMapReaderPrivate;
+    Internal::BinaryMapReaderPrivate *d;
+};
+
+} // namespace Tiled
+
+#endif // BINARYMAPREADER_H
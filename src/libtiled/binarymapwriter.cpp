@@ -0,0 +1,410 @@
+/*
+ * binarymapwriter.cpp
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "binarymapwriter.h"
+
+#include "binarymapformat.h"
+#include "gidmapper.h"
+#include "imagelayer.h"
+#include "map.h"
+#include "mapobject.h"
+#include "mapwriter.h"
+#include "objectgroup.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QStringList>
+#include <QtEndian>
+
+#include <cstring>
+
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+namespace Tiled {
+namespace Internal {
+
+class BinaryMapWriterPrivate
+{
+    Q_DECLARE_TR_FUNCTIONS(BinaryMapWriter)
+
+public:
+    BinaryMapWriterPrivate()
+        : mCompressionLevel(DefaultCompression)
+    {}
+
+    void writeMap(const Map *map, QIODevice *device, const QString &path);
+
+    QString mError;
+    CompressionLevel mCompressionLevel;
+
+private:
+    void writeTileset(const Tileset *tileset, unsigned firstGid);
+    void writeLayerAttributes(const Layer *layer);
+    void writeTileLayer(const TileLayer *tileLayer);
+    void writeObjectGroup(const ObjectGroup *objectGroup);
+    void writeObject(const MapObject *mapObject);
+    void writeImageLayer(const ImageLayer *imageLayer);
+
+    void writeUInt(quint32 value);
+    void writeInt(qint32 value) { writeUInt(quint32(value)); }
+    void writeDouble(double value);
+    void writeString(const QString &string);
+    void writeColor(const QColor &color);
+    void writeBytes(const QByteArray &bytes);
+    void writeProperties(const Properties &properties);
+
+    QString filePath(const QString &fileName) const;
+
+    QDir mMapDir;     // The directory in which the map is being saved
+    bool mUseAbsolutePaths;
+    GidMapper mGidMapper;
+
+    QByteArray mBody;
+    QStringList mStrings;
+    QHash<QString, quint32> mStringIndexes;
+};
+
+} // namespace Internal
+} // namespace Tiled
+
+
+void BinaryMapWriterPrivate::writeMap(const Map *map, QIODevice *device,
+                                      const QString &path)
+{
+    using namespace BinaryMapFormat;
+
+    mMapDir = QDir(path);
+    mUseAbsolutePaths = path.isEmpty();
+    mBody.clear();
+    mStrings.clear();
+    mStringIndexes.clear();
+
+    // The body is written first, since the string table that precedes it is
+    // only complete afterwards
+    writeUInt(map->orientation());
+    writeInt(map->width());
+    writeInt(map->height());
+    writeInt(map->tileWidth());
+    writeInt(map->tileHeight());
+    writeColor(map->backgroundColor());
+    writeInt(map->layerDataFormat());
+    writeProperties(map->properties());
+
+    mGidMapper.clear();
+    writeUInt(map->tilesetCount());
+    unsigned firstGid = 1;
+    foreach (Tileset *tileset, map->tilesets()) {
+        writeTileset(tileset, firstGid);
+        mGidMapper.insert(firstGid, tileset);
+        firstGid += tileset->tileCount();
+    }
+
+    writeUInt(map->layerCount());
+    foreach (const Layer *layer, map->layers()) {
+        switch (layer->type()) {
+        case Layer::TileLayerType:
+            writeUInt(TileLayerKind);
+            writeLayerAttributes(layer);
+            writeTileLayer(static_cast<const TileLayer*>(layer));
+            break;
+        case Layer::ObjectGroupType:
+            writeUInt(ObjectGroupKind);
+            writeLayerAttributes(layer);
+            writeObjectGroup(static_cast<const ObjectGroup*>(layer));
+            break;
+        case Layer::ImageLayerType:
+            writeUInt(ImageLayerKind);
+            writeLayerAttributes(layer);
+            writeImageLayer(static_cast<const ImageLayer*>(layer));
+            break;
+        }
+    }
+
+    QByteArray body;
+    qSwap(body, mBody);
+
+    writeUInt(Magic);
+    writeUInt(Version);
+    writeUInt(mStrings.size());
+    foreach (const QString &string, mStrings)
+        writeBytes(string.toUtf8());
+
+    device->write(mBody);
+    device->write(body);
+
+    mBody.clear();
+    mStrings.clear();
+    mStringIndexes.clear();
+}
+
+void BinaryMapWriterPrivate::writeTileset(const Tileset *tileset,
+                                          unsigned firstGid)
+{
+    using namespace BinaryMapFormat;
+
+    const QString &fileName = tileset->fileName();
+    if (!fileName.isEmpty()) {
+        writeUInt(ExternalTileset);
+        writeUInt(firstGid);
+        writeString(filePath(fileName));
+        return;
+    }
+
+    // Embedded tilesets are rare and small compared to the layer data, so
+    // they are stored as TSX to share the handling of their images
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+
+    MapWriter writer;
+    writer.writeTileset(tileset, &buffer,
+                        mUseAbsolutePaths ? QString() : mMapDir.path());
+
+    writeUInt(EmbeddedTileset);
+    writeUInt(firstGid);
+    writeBytes(buffer.data());
+}
+
+void BinaryMapWriterPrivate::writeLayerAttributes(const Layer *layer)
+{
+    writeString(layer->name());
+    writeInt(layer->x());
+    writeInt(layer->y());
+    writeInt(layer->width());
+    writeInt(layer->height());
+    writeDouble(layer->opacity());
+    writeUInt(layer->isVisible());
+    writeProperties(layer->properties());
+}
+
+void BinaryMapWriterPrivate::writeTileLayer(const TileLayer *tileLayer)
+{
+    using namespace BinaryMapFormat;
+
+    const int width = tileLayer->width();
+    const int height = tileLayer->height();
+
+    // The number of chunks is only known once the empty ones are skipped
+    const int chunkCountOffset = mBody.size();
+    writeUInt(0);
+    quint32 chunkCount = 0;
+
+    QByteArray gids;
+
+    for (int chunkY = 0; chunkY < height; chunkY += ChunkSize) {
+        for (int chunkX = 0; chunkX < width; chunkX += ChunkSize) {
+            const int chunkWidth = qMin(int(ChunkSize), width - chunkX);
+            const int chunkHeight = qMin(int(ChunkSize), height - chunkY);
+
+            gids.resize(chunkWidth * chunkHeight * 4);
+            uchar *out = reinterpret_cast<uchar*>(gids.data());
+            bool empty = true;
+
+            for (int y = chunkY; y < chunkY + chunkHeight; ++y) {
+                for (int x = chunkX; x < chunkX + chunkWidth; ++x) {
+                    const Cell &cell = tileLayer->cellAt(x, y);
+                    const unsigned gid = mGidMapper.cellToGid(cell);
+                    if (gid != 0)
+                        empty = false;
+                    qToLittleEndian<quint32>(gid, out);
+                    out += 4;
+                }
+            }
+
+            if (empty)
+                continue;
+
+            writeInt(chunkX);
+            writeInt(chunkY);
+            writeInt(chunkWidth);
+            writeInt(chunkHeight);
+            writeBytes(compress(gids, Zlib, mCompressionLevel));
+            ++chunkCount;
+        }
+    }
+
+    qToLittleEndian<quint32>(chunkCount, reinterpret_cast<uchar*>(
+                                 mBody.data() + chunkCountOffset));
+}
+
+void BinaryMapWriterPrivate::writeObjectGroup(const ObjectGroup *objectGroup)
+{
+    writeColor(objectGroup->color());
+
+    writeUInt(objectGroup->objectCount());
+    foreach (const MapObject *mapObject, objectGroup->objects())
+        writeObject(mapObject);
+}
+
+void BinaryMapWriterPrivate::writeObject(const MapObject *mapObject)
+{
+    // Positions are kept in tile coordinates, to avoid the rounding that
+    // comes with the pixel coordinates used by TMX
+    writeString(mapObject->name());
+    writeString(mapObject->type());
+    writeUInt(mGidMapper.cellToGid(mapObject->cell()));
+    writeDouble(mapObject->x());
+    writeDouble(mapObject->y());
+    writeDouble(mapObject->width());
+    writeDouble(mapObject->height());
+    writeDouble(mapObject->rotation());
+    writeUInt(mapObject->shape());
+    writeUInt(mapObject->isVisible());
+
+    const QPolygonF &polygon = mapObject->polygon();
+    writeUInt(polygon.size());
+    foreach (const QPointF &point, polygon) {
+        writeDouble(point.x());
+        writeDouble(point.y());
+    }
+
+    writeProperties(mapObject->properties());
+}
+
+void BinaryMapWriterPrivate::writeImageLayer(const ImageLayer *imageLayer)
+{
+    const QString &imageSource = imageLayer->imageSource();
+    writeString(imageSource.isEmpty() ? QString() : filePath(imageSource));
+    writeColor(imageLayer->transparentColor());
+}
+
+void BinaryMapWriterPrivate::writeUInt(quint32 value)
+{
+    uchar bytes[4];
+    qToLittleEndian<quint32>(value, bytes);
+    mBody.append(reinterpret_cast<const char*>(bytes), 4);
+}
+
+void BinaryMapWriterPrivate::writeDouble(double value)
+{
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uchar bytes[8];
+    qToLittleEndian<quint64>(bits, bytes);
+    mBody.append(reinterpret_cast<const char*>(bytes), 8);
+}
+
+void BinaryMapWriterPrivate::writeString(const QString &string)
+{
+    QHash<QString, quint32>::const_iterator it = mStringIndexes.find(string);
+    if (it == mStringIndexes.end()) {
+        it = mStringIndexes.insert(string, mStrings.size());
+        mStrings.append(string);
+    }
+
+    writeUInt(it.value());
+}
+
+void BinaryMapWriterPrivate::writeColor(const QColor &color)
+{
+    writeUInt(color.isValid());
+    writeUInt(color.isValid() ? color.rgba() : 0);
+}
+
+void BinaryMapWriterPrivate::writeBytes(const QByteArray &bytes)
+{
+    writeUInt(bytes.size());
+    mBody.append(bytes);
+}
+
+void BinaryMapWriterPrivate::writeProperties(const Properties &properties)
+{
+    writeUInt(properties.size());
+
+    Properties::const_iterator it = properties.constBegin();
+    Properties::const_iterator it_end = properties.constEnd();
+    for (; it != it_end; ++it) {
+        writeString(it.key());
+        writeString(it.value());
+    }
+}
+
+QString BinaryMapWriterPrivate::filePath(const QString &fileName) const
+{
+    if (mUseAbsolutePaths)
+        return fileName;
+    return mMapDir.relativeFilePath(fileName);
+}
+
+
+BinaryMapWriter::BinaryMapWriter()
+    : d(new BinaryMapWriterPrivate)
+{
+}
+
+BinaryMapWriter::~BinaryMapWriter()
+{
+    delete d;
+}
+
+void BinaryMapWriter::writeMap(const Map *map, QIODevice *device,
+                               const QString &path)
+{
+    d->writeMap(map, device, path);
+}
+
+bool BinaryMapWriter::writeMap(const Map *map, const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        d->mError = BinaryMapWriterPrivate::tr(
+                    "Could not open file for writing.");
+        return false;
+    }
+
+    d->writeMap(map, &file, QFileInfo(fileName).absolutePath());
+
+    if (file.error() != QFile::NoError) {
+        d->mError = file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+QString BinaryMapWriter::errorString() const
+{
+    return d->mError;
+}
+
+void BinaryMapWriter::setCompressionLevel(CompressionLevel level)
+{
+    d->mCompressionLevel = level;
+}
+
+CompressionLevel BinaryMapWriter::compressionLevel() const
+{
+    return d->mCompressionLevel;
+}
@@ -0,0 +1,96 @@
+/*
+ * binarymapwriter.h
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BINARYMAPWRITER_H
+#define BINARYMAPWRITER_H
+
+#include "compression.h"
+#include "tiled_global.h"
+
+#include <QString>
+
+class QIODevice;
+
+namespace Tiled {
+
+class Map;
+
+namespace Internal {
+class BinaryMapWriterPrivate;
+}
+
+/**
+ * A writer for Tiled's binary map format, which is meant to be saved and
+ * loaded as quickly as possible. TMX should be used for interchange.
+ *
+ * \sa BinaryMapReader
+ */
+class TILEDSHARED_EXPORT BinaryMapWriter
+{
+public:
+    BinaryMapWriter();
+    ~BinaryMapWriter();
+
+    /**
+     * Writes a binary map to the given \a device. Optionally a \a path can
+     * be given, which will be used to create relative references to external
+     * images and tilesets.
+     *
+     * Error checking will need to be done on the \a device after calling this
+     * function.
+     */
+    void writeMap(const Map *map, QIODevice *device,
+                  const QString &path = QString());
+
+    /**
+     * Writes a binary map to the given \a fileName.
+     *
+     * Returns false and sets errorString() when writing failed.
+     * \overload
+     */
+    bool writeMap(const Map *map, const QString &fileName);
+
+    /**
+     * Returns the error message for the last occurred error.
+     */
+    QString errorString() const;
+
+    /**
+     * Sets the compression level used for the tile layer data. Defaults to
+     * DefaultCompression.
+     */
+    void setCompressionLevel(CompressionLevel level);
+    CompressionLevel compressionLevel() const;
+
+private:
+    Internal::BinaryMapWriterPrivate *d;
+};
+
+} // namespace Tiled
+
+#endif // BINARYMAPWRITER_H
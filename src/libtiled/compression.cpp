@@ -54,6 +54,30 @@ static void logZlibError(int error)
     }
 }
 
+/**
+ * Maps the \a level to the zlib compression level and strategy, so that it
+ * means the same for compress() and Deflater.
+ */
+static void zlibParameters(CompressionLevel level,
+                           int *zlibLevel, int *strategy)
+{
+    *zlibLevel = Z_DEFAULT_COMPRESSION;
+    *strategy = Z_DEFAULT_STRATEGY;
+
+    switch (level) {
+    case DefaultCompression:
+        break;
+    case FastCompression:
+        // Tile layer data mostly consists of runs of identical GIDs
+        *zlibLevel = Z_BEST_SPEED;
+        *strategy = Z_RLE;
+        break;
+    case BestCompression:
+        *zlibLevel = Z_BEST_COMPRESSION;
+        break;
+    }
+}
+
 QByteArray Tiled::decompress(const QByteArray &data, int expectedSize)
 {
     QByteArray out;
@@ -111,10 +135,10 @@ QByteArray Tiled::decompress(const QByteArray &data, int expectedSize)
     return out;
 }
 
-QByteArray Tiled::compress(const QByteArray &data, CompressionMethod method)
+QByteArray Tiled::compress(const QByteArray &data, CompressionMethod method,
+                           CompressionLevel level)
 {
     QByteArray out;
-    out.resize(1024);
     int err;
     z_stream strm;
     strm.zalloc = Z_NULL;
@@ -122,18 +146,26 @@ QByteArray Tiled::compress(const QByteArray &data, CompressionMethod method)
     strm.opaque = Z_NULL;
     strm.next_in = (Bytef *) data.data();
     strm.avail_in = data.length();
-    strm.next_out = (Bytef *) out.data();
-    strm.avail_out = out.size();
 
     const int windowBits = (method == Gzip) ? 15 + 16 : 15;
 
-    err = deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits,
-                       8, Z_DEFAULT_STRATEGY);
+    int zlibLevel;
+    int strategy;
+    zlibParameters(level, &zlibLevel, &strategy);
+
+    err = deflateInit2(&strm, zlibLevel, Z_DEFLATED, windowBits,
+                       8, strategy);
     if (err != Z_OK) {
         logZlibError(err);
         return QByteArray();
     }
 
+    // The bound should make a single call to deflate sufficient. Growing the
+    // buffer is still supported in case the gzip header makes it fall short.
+    out.resize(deflateBound(&strm, data.length()));
+    strm.next_out = (Bytef *) out.data();
+    strm.avail_out = out.size();
+
     do {
         err = deflate(&strm, Z_FINISH);
         Q_ASSERT(err != Z_STREAM_ERROR);
@@ -160,3 +192,147 @@ QByteArray Tiled::compress(const QByteArray &data, CompressionMethod method)
     out.resize(outLength);
     return out;
 }
+
+quint32 Tiled::crc32(quint32 crc, const char *data, int length)
+{
+    return ::crc32(crc, reinterpret_cast<const Bytef*>(data), length);
+}
+
+
+Inflater::Inflater()
+    : mStream(new z_stream)
+    , mAtEnd(false)
+{
+    mStream->zalloc = Z_NULL;
+    mStream->zfree = Z_NULL;
+    mStream->opaque = Z_NULL;
+    mStream->next_in = Z_NULL;
+    mStream->avail_in = 0;
+
+    const int ret = inflateInit2(mStream, 15 + 32);
+    mValid = ret == Z_OK;
+    if (!mValid)
+        logZlibError(ret);
+}
+
+Inflater::~Inflater()
+{
+    if (mValid)
+        inflateEnd(mStream);
+    delete mStream;
+}
+
+void Inflater::setInput(const char *data, int length)
+{
+    mStream->next_in = (Bytef *) data;
+    mStream->avail_in = length;
+}
+
+bool Inflater::needsInput() const
+{
+    return mStream->avail_in == 0;
+}
+
+int Inflater::inflate(char *out, int size)
+{
+    if (!mValid)
+        return -1;
+    if (mAtEnd || size == 0)
+        return 0;
+
+    mStream->next_out = (Bytef *) out;
+    mStream->avail_out = size;
+
+    int ret = ::inflate(mStream, Z_SYNC_FLUSH);
+
+    switch (ret) {
+        case Z_NEED_DICT:
+        case Z_STREAM_ERROR:
+            ret = Z_DATA_ERROR;
+        case Z_DATA_ERROR:
+        case Z_MEM_ERROR:
+            logZlibError(ret);
+            inflateEnd(mStream);
+            mValid = false;
+            return -1;
+        case Z_STREAM_END:
+            mAtEnd = true;
+            break;
+    }
+
+    return size - mStream->avail_out;
+}
+
+
+Deflater::Deflater(CompressionMethod method, CompressionLevel level)
+    : mStream(new z_stream)
+{
+    mStream->zalloc = Z_NULL;
+    mStream->zfree = Z_NULL;
+    mStream->opaque = Z_NULL;
+
+    const int windowBits = (method == Gzip) ? 15 + 16 : 15;
+
+    int zlibLevel;
+    int strategy;
+    zlibParameters(level, &zlibLevel, &strategy);
+
+    const int ret = deflateInit2(mStream, zlibLevel, Z_DEFLATED, windowBits,
+                                 8, strategy);
+    mValid = ret == Z_OK;
+    if (!mValid)
+        logZlibError(ret);
+}
+
+Deflater::~Deflater()
+{
+    if (mValid)
+        deflateEnd(mStream);
+    delete mStream;
+}
+
+QByteArray Deflater::deflate(const char *data, int length)
+{
+    return process(data, length, Z_NO_FLUSH);
+}
+
+QByteArray Deflater::finish()
+{
+    QByteArray out = process(0, 0, Z_FINISH);
+    if (mValid) {
+        deflateEnd(mStream);
+        mValid = false;
+    }
+    return out;
+}
+
+QByteArray Deflater::process(const char *data, int length, int flush)
+{
+    QByteArray out;
+    if (!mValid)
+        return out;
+
+    mStream->next_in = (Bytef *) data;
+    mStream->avail_in = length;
+
+    // Keep compressing until the input is consumed and, when finishing,
+    // until the end of the stream has been written
+    int outLength = 0;
+    int ret;
+    do {
+        if (outLength == out.size())
+            out.resize(qMax(out.size() * 2, 16384));
+
+        mStream->next_out = (Bytef *)(out.data() + outLength);
+        mStream->avail_out = out.size() - outLength;
+
+        ret = ::deflate(mStream, flush);
+        Q_ASSERT(ret != Z_STREAM_ERROR);
+
+        outLength = out.size() - mStream->avail_out;
+    } while (mStream->avail_out == 0 ||
+             (flush == Z_FINISH && ret != Z_STREAM_END));
+
+    out.resize(outLength);
+    return out;
+}
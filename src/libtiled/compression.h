@@ -33,6 +33,8 @@
 
 class QByteArray;
 
+struct z_stream_s;
+
 namespace Tiled {
 
 enum CompressionMethod {
@@ -40,6 +42,15 @@ enum CompressionMethod {
     Zlib
 };
 
+/**
+ * Trade-offs between speed and size when compressing data.
+ */
+enum CompressionLevel {
+    DefaultCompression,
+    FastCompression,    // Lowest level, run-length encoding strategy
+    BestCompression     // Highest level, slowest
+};
+
 /**
  * Decompresses either zlib or gzip compressed memory. Returns a null
  * QByteArray if decompressing failed.
@@ -61,11 +72,101 @@ QByteArray TILEDSHARED_EXPORT decompress(const QByteArray &data,
  *
  * Needed because qCompress does not support gzip compression.
  *
- * @param data the uncompressed data
+ * @param data   the uncompressed data
+ * @param method the format of the compressed data
+ * @param level  the compression level to use
  * @return the compressed data, or a null QByteArray if compression failed
  */
 QByteArray TILEDSHARED_EXPORT compress(const QByteArray &data,
-                                       CompressionMethod method = Zlib);
+                                       CompressionMethod method = Zlib,
+                                       CompressionLevel level = DefaultCompression);
+
+/**
+ * Updates the CRC-32 checksum \a crc with the next \a length bytes of
+ * \a data, using the same checksum as gzip and PNG. The checksum of the first
+ * bytes is computed by passing 0 as \a crc.
+ */
+quint32 TILEDSHARED_EXPORT crc32(quint32 crc, const char *data, int length);
+
+/**
+ * Incrementally decompresses either zlib or gzip compressed data. Unlike
+ * decompress(), this allows the data to be passed in and taken out in chunks
+ * of any size, so that neither the compressed nor the uncompressed data needs
+ * to be held in memory as a whole.
+ */
+class TILEDSHARED_EXPORT Inflater
+{
+public:
+    Inflater();
+    ~Inflater();
+
+    /**
+     * Sets the next chunk of compressed data. The data needs to stay valid
+     * until needsInput() returns true.
+     */
+    void setInput(const char *data, int length);
+
+    /**
+     * Returns whether all compressed data passed to setInput() was consumed.
+     */
+    bool needsInput() const;
+
+    /**
+     * Returns whether the end of the compressed stream has been reached.
+     */
+    bool atEnd() const { return mAtEnd; }
+
+    /**
+     * Decompresses up to \a size bytes into \a out.
+     *
+     * @return the number of bytes written, or -1 when the data is corrupt
+     */
+    int inflate(char *out, int size);
+
+private:
+    Q_DISABLE_COPY(Inflater)
+
+    z_stream_s *mStream;
+    bool mValid;
+    bool mAtEnd;
+};
+
+/**
+ * Incrementally compresses data in either zlib or gzip format. Unlike
+ * compress(), this allows the data to be passed in chunks, so that the
+ * uncompressed data never needs to be held in memory as a whole.
+ */
+class TILEDSHARED_EXPORT Deflater
+{
+public:
+    explicit Deflater(CompressionMethod method = Zlib,
+                      CompressionLevel level = DefaultCompression);
+    ~Deflater();
+
+    /**
+     * Returns whether the compressor could be set up and no error occurred.
+     */
+    bool isValid() const { return mValid; }
+
+    /**
+     * Compresses the next \a length bytes of \a data. Returns the compressed
+     * output that became available, which may be empty.
+     */
+    QByteArray deflate(const char *data, int length);
+
+    /**
+     * Ends the compressed stream and returns the remaining output.
+     */
+    QByteArray finish();
+
+private:
+    Q_DISABLE_COPY(Deflater)
+
+    QByteArray process(const char *data, int length, int flush);
+
+    z_stream_s *mStream;
+    bool mValid;
+};
 
 } // namespace Tiled
 
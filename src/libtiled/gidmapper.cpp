@@ -39,6 +39,10 @@ const int FlippedHorizontallyFlag   = 0x80000000;
 const int FlippedVerticallyFlag     = 0x40000000;
 const int FlippedAntiDiagonallyFlag = 0x20000000;
 
+// The flags are stored in the same order as Cell::FlipFlag, which allows
+// converting them with a single shift
+const int FlipFlagsShift = 29;
+
 GidMapper::GidMapper()
 {
 }
@@ -52,14 +56,50 @@ GidMapper::GidMapper(const QList<Tileset *> &tilesets)
     }
 }
 
+void GidMapper::insert(unsigned firstGid, Tileset *tileset)
+{
+    Tileset *replaced = mFirstGidToTileset.value(firstGid);
+    mFirstGidToTileset.insert(firstGid, tileset);
+
+    // When the replaced tileset was known by this first GID, fall back to its
+    // lowest remaining first GID, if it is still mapped elsewhere
+    if (replaced && replaced != tileset &&
+            mTilesetToFirstGid.value(replaced) == firstGid) {
+        mTilesetToFirstGid.remove(replaced);
+
+        QMap<unsigned, Tileset*>::const_iterator it =
+                mFirstGidToTileset.constBegin();
+        QMap<unsigned, Tileset*>::const_iterator it_end =
+                mFirstGidToTileset.constEnd();
+        for (; it != it_end; ++it) {
+            if (it.value() == replaced) {
+                mTilesetToFirstGid.insert(replaced, it.key());
+                break;
+            }
+        }
+    }
+
+    // When a tileset is inserted more than once, its lowest first GID is used
+    QHash<const Tileset*, unsigned>::iterator i =
+            mTilesetToFirstGid.find(tileset);
+    if (i == mTilesetToFirstGid.end())
+        mTilesetToFirstGid.insert(tileset, firstGid);
+    else if (firstGid < i.value())
+        i.value() = firstGid;
+}
+
+void GidMapper::clear()
+{
+    mFirstGidToTileset.clear();
+    mTilesetToFirstGid.clear();
+}
+
 Cell GidMapper::gidToCell(unsigned gid, bool &ok) const
 {
     Cell result;
 
     // Read out the flags
-    result.flippedHorizontally = (gid & FlippedHorizontallyFlag);
-    result.flippedVertically = (gid & FlippedVerticallyFlag);
-    result.flippedAntiDiagonally = (gid & FlippedAntiDiagonallyFlag);
+    result.setFlipFlags(gid >> FlipFlagsShift);
 
     // Clear the flags
     gid &= ~(FlippedHorizontallyFlag |
@@ -86,9 +126,9 @@ Cell GidMapper::gidToCell(unsigned gid, bool &ok) const
                 tileId = row * tileset->columnCount() + column;
             }
 
-            result.tile = tileset->tileAt(tileId);
+            result.setTile(tileset->tileAt(tileId));
         } else {
-            result.tile = 0;
+            result.setTile(0);
         }
 
         ok = true;
@@ -97,31 +137,88 @@ Cell GidMapper::gidToCell(unsigned gid, bool &ok) const
     return result;
 }
 
+int GidMapper::gidsToCells(const unsigned *gids, int count, Cell *cells) const
+{
+    const unsigned flagsMask = FlippedHorizontallyFlag |
+                               FlippedVerticallyFlag |
+                               FlippedAntiDiagonallyFlag;
+
+    // The gid range covered by the last used tileset
+    unsigned rangeStart = 1;
+    unsigned rangeEnd = 1;
+    const Tileset *tileset = 0;
+    int columnCount = 0;
+
+    const QMap<unsigned, Tileset*>::const_iterator begin =
+            mFirstGidToTileset.begin();
+    const QMap<unsigned, Tileset*>::const_iterator end =
+            mFirstGidToTileset.end();
+
+    for (int index = 0; index < count; ++index) {
+        const unsigned flaggedGid = gids[index];
+        const unsigned gid = flaggedGid & ~flagsMask;
+        Cell &cell = cells[index];
+
+        cell = Cell();
+        cell.setFlipFlags(flaggedGid >> FlipFlagsShift);
+
+        if (gid == 0)
+            continue;
+
+        if (gid < rangeStart || gid >= rangeEnd) {
+            // Find the tileset containing this tile
+            QMap<unsigned, Tileset*>::const_iterator i =
+                    mFirstGidToTileset.upperBound(gid);
+            if (i == begin)
+                return index;
+
+            rangeEnd = (i == end) ? flagsMask : i.key();
+            --i; // Navigate one tileset back since upper bound finds the next
+            rangeStart = i.key();
+            tileset = i.value();
+
+            // Correct tile indexes for changes in image width
+            columnCount = 0;
+            if (tileset) {
+                const int originalColumnCount =
+                        mTilesetColumnCounts.value(tileset);
+                if (originalColumnCount != tileset->columnCount())
+                    columnCount = originalColumnCount;
+            }
+        }
+
+        if (!tileset)
+            continue;
+
+        int tileId = gid - rangeStart;
+        if (columnCount > 0) {
+            const int row = tileId / columnCount;
+            const int column = tileId % columnCount;
+            tileId = row * tileset->columnCount() + column;
+        }
+
+        cell.setTile(tileset->tileAt(tileId));
+    }
+
+    return -1;
+}
+
 unsigned GidMapper::cellToGid(const Cell &cell) const
 {
     if (cell.isEmpty())
         return 0;
 
-    const Tileset *tileset = cell.tile->tileset();
+    const Tileset *tileset = cell.tile()->tileset();
 
     // Find the first GID for the tileset
-    QMap<unsigned, Tileset*>::const_iterator i = mFirstGidToTileset.begin();
-    QMap<unsigned, Tileset*>::const_iterator i_end = mFirstGidToTileset.end();
-    while (i != i_end && i.value() != tileset)
-        ++i;
+    QHash<const Tileset*, unsigned>::const_iterator i =
+            mTilesetToFirstGid.find(tileset);
 
-    if (i == i_end) // tileset not found
+    if (i == mTilesetToFirstGid.end()) // tileset not found
         return 0;
 
-    unsigned gid = i.key() + cell.tile->id();
-    if (cell.flippedHorizontally)
-        gid |= FlippedHorizontallyFlag;
-    if (cell.flippedVertically)
-        gid |= FlippedVerticallyFlag;
-    if (cell.flippedAntiDiagonally)
-        gid |= FlippedAntiDiagonallyFlag;
-
-    return gid;
+    const unsigned gid = i.value() + cell.tile()->id();
+    return gid | (cell.flipFlags() << FlipFlagsShift);
 }
 
 void GidMapper::setTilesetWidth(const Tileset *tileset, int width)
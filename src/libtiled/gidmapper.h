@@ -31,6 +31,7 @@
 
 #include "tilelayer.h"
 
+#include <QHash>
 #include <QMap>
 
 namespace Tiled {
@@ -55,13 +56,12 @@ public:
     /**
      * Insert the given \a tileset with \a firstGid as its first global ID.
      */
-    void insert(unsigned firstGid, Tileset *tileset)
-    { mFirstGidToTileset.insert(firstGid, tileset); }
+    void insert(unsigned firstGid, Tileset *tileset);
 
     /**
      * Clears the gid mapper, so that it can be reused.
      */
-    void clear() { mFirstGidToTileset.clear(); }
+    void clear();
 
     /**
      * Returns true when no tilesets are known to this gid mapper.
@@ -74,6 +74,17 @@ public:
      */
     Cell gidToCell(unsigned gid, bool &ok) const;
 
+    /**
+     * Converts the \a count global tile IDs in \a gids to cells, which are
+     * stored in \a cells. This is equivalent to calling gidToCell() for each
+     * gid, but much faster since the tileset range of the last tile is
+     * reused as long as following tiles fall within it.
+     *
+     * Returns the index of the first gid that could not be converted, or -1
+     * when all gids were converted successfully.
+     */
+    int gidsToCells(const unsigned *gids, int count, Cell *cells) const;
+
     /**
      * Returns the global tile ID for the given \a cell. Returns 0 when the
      * cell is empty or when its tileset isn't known.
@@ -89,6 +100,7 @@ public:
 
 private:
     QMap<unsigned, Tileset*> mFirstGidToTileset;
+    QHash<const Tileset*, unsigned> mTilesetToFirstGid;
     QMap<const Tileset*, int> mTilesetColumnCounts;
 };
 
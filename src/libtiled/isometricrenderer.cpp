@@ -69,8 +69,8 @@ QRectF IsometricRenderer::boundingRect(const MapObject *object) const
 
     if (!object->cell().isEmpty()) {
         const QPointF bottomCenter = tileToPixelCoords(object->position());
-        const Tile *tile = object->cell().tile;
-        const QSize imgSize = tile->image().size();
+        const Tile *tile = object->cell().tile();
+        const QSize imgSize = tile->size();
         const QPoint tileOffset = tile->tileset()->tileOffset();
         return QRectF(bottomCenter.x() + tileOffset.x() - imgSize.width() / 2,
                       bottomCenter.y() + tileOffset.y() - imgSize.height(),
@@ -161,6 +161,11 @@ void IsometricRenderer::drawTileLayer(QPainter *painter,
                                       const TileLayer *layer,
                                       const QRectF &exposed) const
 {
+    if (useLowDetail(painter)) {
+        drawTileLayerAtLowDetail(painter, layer, exposed);
+        return;
+    }
+
     const int tileWidth = map()->tileWidth();
     const int tileHeight = map()->tileHeight();
 
@@ -213,7 +218,7 @@ void IsometricRenderer::drawTileLayer(QPainter *painter,
     // Determine whether the current row is shifted half a tile to the right
     bool shifted = inUpperHalf ^ inLeftHalf;
 
-    QTransform baseTransform = painter->transform();
+    CellRenderer renderer(painter);
 
     for (int y = startPos.y(); y - tileHeight < rect.bottom();
          y += tileHeight / 2)
@@ -224,10 +229,7 @@ void IsometricRenderer::drawTileLayer(QPainter *painter,
             if (layer->contains(columnItr)) {
                 const Cell &cell = layer->cellAt(columnItr);
                 if (!cell.isEmpty()) {
-                    drawCell(painter, cell,
-                             QPointF(x, y),
-                             BottomLeft,
-                             baseTransform);
+                    renderer.render(cell, QPointF(x, y), BottomLeft);
                 }
             }
 
@@ -247,8 +249,6 @@ void IsometricRenderer::drawTileLayer(QPainter *painter,
             shifted = false;
         }
     }
-
-    painter->setTransform(baseTransform);
 }
 
 void IsometricRenderer::drawTileSelection(QPainter *painter,
@@ -274,7 +274,7 @@ void IsometricRenderer::drawMapObject(QPainter *painter,
     QPen pen(Qt::black, 0);
 
     if (!object->cell().isEmpty()) {
-        const Tile *tile = object->cell().tile;
+        const Tile *tile = object->cell().tile();
         const QSize imgSize = tile->size();
         const QPointF pos = tileToPixelCoords(object->position());
 
@@ -51,7 +51,9 @@ DEFINES += QT_NO_CAST_FROM_ASCII \
 DEFINES += TILED_LIBRARY
 contains(QT_CONFIG, reduce_exports): CONFIG += hide_symbols
 
-SOURCES += compression.cpp \
+SOURCES += binarymapreader.cpp \
+    binarymapwriter.cpp \
+    compression.cpp \
     gidmapper.cpp \
     imagelayer.cpp \
     isometricrenderer.cpp \
@@ -67,8 +69,12 @@ SOURCES += compression.cpp \
     staggeredrenderer.cpp \
     tile.cpp \
     tilelayer.cpp \
-    tileset.cpp
-HEADERS += compression.h \
+    tileset.cpp \
+    tilesetcache.cpp
+HEADERS += binarymapformat.h \
+    binarymapreader.h \
+    binarymapwriter.h \
+    compression.h \
     gidmapper.h \
     imagelayer.h \
     isometricrenderer.h \
@@ -90,7 +96,8 @@ HEADERS += compression.h \
     tiled.h \
     tiled_global.h \
     tilelayer.h \
-    tileset.h
+    tileset.h \
+    tilesetcache.h
 
 contains(INSTALL_HEADERS, yes) {
     headers.files = $${HEADERS}
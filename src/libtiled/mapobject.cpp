@@ -58,9 +58,9 @@ void MapObject::flip(FlipDirection direction)
 {
     if (!mCell.isEmpty()) {
         if (direction == FlipHorizontally)
-            mCell.flippedHorizontally = !mCell.flippedHorizontally;
+            mCell.toggleFlipFlags(Cell::FlippedHorizontally);
         else if (direction == FlipVertically)
-            mCell.flippedVertically = !mCell.flippedVertically;
+            mCell.toggleFlipFlags(Cell::FlippedVertically);
     }
 
     if (!mPolygon.isEmpty()) {
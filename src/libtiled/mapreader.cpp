@@ -39,21 +39,87 @@
 #include "tile.h"
 #include "tilelayer.h"
 #include "tileset.h"
+#include "tilesetcache.h"
 #include "terrain.h"
 
+#include <QBuffer>
 #include <QCoreApplication>
 #include <QDebug>
 #include <QDir>
 #include <QFileInfo>
+#include <QRunnable>
+#include <QThreadPool>
 #include <QVector>
+#include <QtEndian>
 #include <QXmlStreamReader>
 
+#include <climits>
+
 using namespace Tiled;
 using namespace Tiled::Internal;
 
+// Files smaller than this are copied rather than memory mapped
+static const qint64 MappedFileThreshold = 16 * 1024 * 1024;
+
 namespace Tiled {
 namespace Internal {
 
+/**
+ * Decodes the base64 or CSV encoded data of a tile layer.
+ *
+ * Since it only reads from the GidMapper and only modifies its own tile
+ * layer, which should not be part of a map yet, decoders for different layers
+ * can run in parallel on a QThreadPool.
+ */
+class LayerDataDecoder : public QRunnable
+{
+    Q_DECLARE_TR_FUNCTIONS(MapReader)
+
+public:
+    LayerDataDecoder(TileLayer *tileLayer,
+                     const GidMapper &gidMapper,
+                     const QStringRef &encoding,
+                     const QStringRef &compression,
+                     const QByteArray &data,
+                     qint64 lineNumber,
+                     qint64 columnNumber);
+
+    void run();
+
+    /**
+     * Returns the error message, or an empty string if decoding succeeded.
+     */
+    const QString &error() const { return mError; }
+
+    /**
+     * Returns the location of the layer data in the document, for error
+     * reporting.
+     */
+    qint64 lineNumber() const { return mLineNumber; }
+    qint64 columnNumber() const { return mColumnNumber; }
+
+private:
+    void decodeBinaryLayerData();
+    void decodeCSVLayerData();
+
+    /**
+     * Converts the \a count global tile IDs in \a gids to \a cells. Sets
+     * the error message when a global tile ID is invalid.
+     *
+     * @return whether all global tile IDs could be converted
+     */
+    bool cellsForGids(const unsigned *gids, int count, Cell *cells);
+
+    TileLayer *mTileLayer;
+    const GidMapper &mGidMapper;
+    QString mEncoding;
+    QString mCompression;
+    QByteArray mData;
+    qint64 mLineNumber;
+    qint64 mColumnNumber;
+    QString mError;
+};
+
 class MapReaderPrivate
 {
     Q_DECLARE_TR_FUNCTIONS(MapReader)
@@ -64,7 +130,11 @@ public:
     MapReaderPrivate(MapReader *mapReader):
         p(mapReader),
         mMap(0),
-        mReadingExternalTileset(false)
+        mReadingExternalTileset(false),
+        mParallelDecoding(true),
+        mTilesetCache(0),
+        mMappedDataPosition(0),
+        mMappedDataSkew(0)
     {}
 
     Map *readMap(QIODevice *device, const QString &path);
@@ -87,10 +157,20 @@ private:
 
     TileLayer *readLayer();
     void readLayerData(TileLayer *tileLayer);
-    void decodeBinaryLayerData(TileLayer *tileLayer,
-                               const QStringRef &text,
-                               const QStringRef &compression);
-    void decodeCSVLayerData(TileLayer *tileLayer, const QString &text);
+
+    /**
+     * Returns the bytes of the given layer data \a text, which follows the
+     * <data> start tag that ended at the character offset \a dataOffset.
+     * When the bytes of the file are available, these refer directly to
+     * them where possible, rather than being a copy.
+     */
+    QByteArray layerData(const QStringRef &text, qint64 dataOffset);
+
+    /**
+     * Runs the layer data decoders that were deferred while reading the map.
+     * Returns false and sets the error message when any of them failed.
+     */
+    bool decodePendingLayerData();
 
     /**
      * Returns the cell for the given global tile ID. Errors are raised with
@@ -120,6 +200,13 @@ private:
     QList<Tileset*> mCreatedTilesets;
     GidMapper mGidMapper;
     bool mReadingExternalTileset;
+    bool mParallelDecoding;
+    QList<LayerDataDecoder*> mPendingLayerData;
+    TilesetCache *mTilesetCache;
+
+    QByteArray mMappedData;     // The bytes of the file, when available
+    int mMappedDataPosition;    // Where to look for the next layer data
+    qint64 mMappedDataSkew;     // Bytes more than characters before it
 
     QXmlStreamReader xml;
 };
@@ -227,29 +314,42 @@ Map *MapReaderPrivate::readMap()
     if (!bgColorString.isEmpty())
         mMap->setBackgroundColor(QColor(bgColorString.toString()));
 
+    // The layers are only added to the map once their data has been decoded,
+    // so that the decoders don't have to touch the map
+    QList<Layer*> layers;
+
     while (xml.readNextStartElement()) {
         if (xml.name() == QLatin1String("properties"))
             mMap->mergeProperties(readProperties());
         else if (xml.name() == QLatin1String("tileset"))
             mMap->addTileset(readTileset());
         else if (xml.name() == QLatin1String("layer"))
-            mMap->addLayer(readLayer());
+            layers.append(readLayer());
         else if (xml.name() == QLatin1String("objectgroup"))
-            mMap->addLayer(readObjectGroup());
+            layers.append(readObjectGroup());
         else if (xml.name() == QLatin1String("imagelayer"))
-            mMap->addLayer(readImageLayer());
+            layers.append(readImageLayer());
         else
             readUnknownElement();
     }
 
+    const bool decoded = !xml.hasError() && decodePendingLayerData();
+
+    qDeleteAll(mPendingLayerData);
+    mPendingLayerData.clear();
+
     // Clean up in case of error
-    if (xml.hasError()) {
+    if (!decoded) {
         // The tilesets are not owned by the map
         qDeleteAll(mCreatedTilesets);
         mCreatedTilesets.clear();
 
+        qDeleteAll(layers);
         delete mMap;
         mMap = 0;
+    } else {
+        foreach (Layer *layer, layers)
+            mMap->addLayer(layer);
     }
 
     return mMap;
@@ -371,7 +471,7 @@ void MapReaderPrivate::readTilesetTile(Tileset *tileset)
         if (xml.name() == QLatin1String("properties")) {
             tile->mergeProperties(readProperties());
         } else if (xml.name() == QLatin1String("image")) {
-            tileset->setTileImage(id, QPixmap::fromImage(readImage()));
+            tileset->setTileImage(id, readImage());
         } else {
             readUnknownElement();
         }
@@ -511,6 +611,7 @@ void MapReaderPrivate::readLayerData(TileLayer *tileLayer)
     const QXmlStreamAttributes atts = xml.attributes();
     QStringRef encoding = atts.value(QLatin1String("encoding"));
     QStringRef compression = atts.value(QLatin1String("compression"));
+    const qint64 dataOffset = xml.characterOffset();
 
     bool respect = true; // TODO: init from preferences
     if (respect) {
@@ -557,95 +658,410 @@ void MapReaderPrivate::readLayerData(TileLayer *tileLayer)
                 readUnknownElement();
             }
         } else if (xml.isCharacters() && !xml.isWhitespace()) {
-            if (encoding == QLatin1String("base64")) {
-                decodeBinaryLayerData(tileLayer,
-                                      xml.text(),
-                                      compression);
-            } else if (encoding == QLatin1String("csv")) {
-                decodeCSVLayerData(tileLayer, xml.text().toString());
-            } else {
+            if (encoding != QLatin1String("base64")
+                    && encoding != QLatin1String("csv")) {
                 xml.raiseError(tr("Unknown encoding: %1")
                                .arg(encoding.toString()));
                 continue;
             }
+
+            LayerDataDecoder *decoder =
+                    new LayerDataDecoder(tileLayer, mGidMapper,
+                                         encoding, compression,
+                                         layerData(xml.text(), dataOffset),
+                                         xml.lineNumber(),
+                                         xml.columnNumber());
+
+            if (mParallelDecoding) {
+                mPendingLayerData.append(decoder);
+            } else {
+                decoder->run();
+                if (!decoder->error().isEmpty())
+                    xml.raiseError(decoder->error());
+                delete decoder;
+            }
+        }
+    }
+}
+
+/**
+ * Returns whether the \a raw bytes from the file are equal to the \a text
+ * that was read from them, taking into account the normalization of line
+ * endings done by the XML parser.
+ */
+static bool rawDataMatches(const char *raw, const char *end,
+                           const QStringRef &text)
+{
+    const QChar *c = text.unicode();
+    const QChar *textEnd = c + text.size();
+
+    while (raw != end) {
+        char r = *raw++;
+        if (r == '\r') {
+            if (raw != end && *raw == '\n')
+                continue;
+            r = '\n';
         }
+
+        if (c == textEnd || c->unicode() != uchar(r))
+            return false;
+        ++c;
     }
+
+    return c == textEnd;
 }
 
-void MapReaderPrivate::decodeBinaryLayerData(TileLayer *tileLayer,
-                                             const QStringRef &text,
-                                             const QStringRef &compression)
+QByteArray MapReaderPrivate::layerData(const QStringRef &text,
+                                       qint64 dataOffset)
 {
+    if (!mMappedData.isNull()) {
+        // The layer data is looked up as the contents of a <data> element
+        // and verified against the text, so that anything unexpected
+        // (comments, CDATA sections, entities) falls back to copying.
+        //
+        // Since a character takes at least one byte, the contents start no
+        // earlier than the character offset of the parser, plus the skew
+        // found for the previous layer. Earlier <data> elements, like those
+        // of embedded images or XML encoded layers, are passed over. Each
+        // element is looked at only once while reading the file.
+        const char *bytes = mMappedData.constData();
+        const qint64 minimumStart = dataOffset + mMappedDataSkew;
+        int tag;
+
+        while ((tag = mMappedData.indexOf("<data", mMappedDataPosition)) != -1) {
+            const int start = mMappedData.indexOf('>', tag + 5) + 1;
+            const int end = start == 0 ? -1 : mMappedData.indexOf('<', start);
+            if (end == -1) {
+                mMappedDataPosition = mMappedData.size();
+                break;
+            }
+
+            mMappedDataPosition = end;
+            if (start < minimumStart)
+                continue;
+
+            if (rawDataMatches(bytes + start, bytes + end, text)) {
+                mMappedDataSkew = start - dataOffset;
+                return QByteArray::fromRawData(bytes + start, end - start);
+            }
+            break;
+        }
+
+        if (tag == -1)
+            mMappedDataPosition = mMappedData.size();
+    }
+
 #if QT_VERSION < 0x040800
     const QString textData = QString::fromRawData(text.unicode(), text.size());
-    const QByteArray latin1Text = textData.toLatin1();
+    return textData.toLatin1();
 #else
-    const QByteArray latin1Text = text.toLatin1();
+    return text.toLatin1();
 #endif
-    QByteArray tileData = QByteArray::fromBase64(latin1Text);
-    const int size = (tileLayer->width() * tileLayer->height()) * 4;
-
-    if (compression == QLatin1String("zlib")
-        || compression == QLatin1String("gzip")) {
-        tileData = decompress(tileData, size);
-    } else if (!compression.isEmpty()) {
-        xml.raiseError(tr("Compression method '%1' not supported")
-                       .arg(compression.toString()));
-        return;
+}
+
+bool MapReaderPrivate::decodePendingLayerData()
+{
+    if (mPendingLayerData.size() == 1) {
+        mPendingLayerData.first()->run();
+    } else if (!mPendingLayerData.isEmpty()) {
+        // A pool of our own, so that reading only waits for its own layers
+        QThreadPool threadPool;
+
+        foreach (LayerDataDecoder *decoder, mPendingLayerData) {
+            decoder->setAutoDelete(false);
+            threadPool.start(decoder);
+        }
+
+        threadPool.waitForDone();
     }
 
-    if (size != tileData.length()) {
-        xml.raiseError(tr("Corrupt layer data for layer '%1'")
-                       .arg(tileLayer->name()));
-        return;
+    foreach (const LayerDataDecoder *decoder, mPendingLayerData) {
+        if (!decoder->error().isEmpty()) {
+            mError = tr("%3\n\nLine %1, column %2")
+                    .arg(decoder->lineNumber())
+                    .arg(decoder->columnNumber())
+                    .arg(decoder->error());
+            return false;
+        }
     }
 
-    const unsigned char *data =
-            reinterpret_cast<const unsigned char*>(tileData.constData());
-    int x = 0;
-    int y = 0;
+    return true;
+}
+
+LayerDataDecoder::LayerDataDecoder(TileLayer *tileLayer,
+                                   const GidMapper &gidMapper,
+                                   const QStringRef &encoding,
+                                   const QStringRef &compression,
+                                   const QByteArray &data,
+                                   qint64 lineNumber,
+                                   qint64 columnNumber)
+    : mTileLayer(tileLayer)
+    , mGidMapper(gidMapper)
+    , mEncoding(encoding.toString())
+    , mCompression(compression.toString())
+    , mData(data)
+    , mLineNumber(lineNumber)
+    , mColumnNumber(columnNumber)
+{
+}
+
+void LayerDataDecoder::run()
+{
+    if (mEncoding == QLatin1String("base64"))
+        decodeBinaryLayerData();
+    else
+        decodeCSVLayerData();
+
+    // Release the encoded data as soon as possible
+    mData = QByteArray();
+}
+
+namespace {
+
+/**
+ * Decodes base64 encoded data in chunks, so that it does not need to be
+ * decoded as a whole up front. Like QByteArray::fromBase64, any characters
+ * outside of the base64 alphabet (whitespace, padding) are skipped.
+ */
+class Base64Decoder
+{
+public:
+    explicit Base64Decoder(const QByteArray &data)
+        : mIn(data.constData())
+        , mEnd(mIn + data.size())
+        , mBuffer(0)
+        , mBits(0)
+    {}
+
+    bool atEnd() const { return mIn == mEnd; }
+
+    /**
+     * Decodes up to \a size bytes into \a out and returns the number of
+     * bytes written.
+     */
+    int decode(char *out, int size)
+    {
+        int written = 0;
 
-    for (int i = 0; i < size - 3; i += 4) {
-        const unsigned gid = data[i] |
-                             data[i + 1] << 8 |
-                             data[i + 2] << 16 |
-                             data[i + 3] << 24;
+        while (written < size && mIn != mEnd) {
+            const int value = base64Value(*mIn++);
+            if (value == -1)
+                continue;
 
-        tileLayer->setCell(x, y, cellForGid(gid));
+            mBuffer = (mBuffer << 6) | value;
+            mBits += 6;
 
-        x++;
-        if (x == tileLayer->width()) {
-            x = 0;
-            y++;
+            if (mBits >= 8) {
+                mBits -= 8;
+                out[written++] = char(mBuffer >> mBits);
+                mBuffer &= (1u << mBits) - 1;
+            }
         }
+
+        return written;
     }
-}
 
-void MapReaderPrivate::decodeCSVLayerData(TileLayer *tileLayer, const QString &text)
+private:
+    static int base64Value(char c)
+    {
+        if (c >= 'A' && c <= 'Z')
+            return c - 'A';
+        if (c >= 'a' && c <= 'z')
+            return c - 'a' + 26;
+        if (c >= '0' && c <= '9')
+            return c - '0' + 52;
+        if (c == '+')
+            return 62;
+        if (c == '/')
+            return 63;
+        return -1;
+    }
+
+    const char *mIn;
+    const char *mEnd;
+    unsigned mBuffer;
+    int mBits;
+};
+
+} // anonymous namespace
+
+void LayerDataDecoder::decodeBinaryLayerData()
 {
-    QString trimText = text.trimmed();
-    QStringList tiles = trimText.split(QLatin1Char(','));
+    const bool compressed = mCompression == QLatin1String("zlib")
+            || mCompression == QLatin1String("gzip");
 
-    if (tiles.length() != tileLayer->width() * tileLayer->height()) {
-        xml.raiseError(tr("Corrupt layer data for layer '%1'")
-                       .arg(tileLayer->name()));
+    if (!compressed && !mCompression.isEmpty()) {
+        mError = tr("Compression method '%1' not supported")
+                .arg(mCompression);
         return;
     }
 
-    for (int y = 0; y < tileLayer->height(); y++) {
-        for (int x = 0; x < tileLayer->width(); x++) {
-            bool conversionOk;
-            const unsigned gid = tiles.at(y * tileLayer->width() + x)
-                    .toUInt(&conversionOk);
-            if (!conversionOk) {
-                xml.raiseError(
-                        tr("Unable to parse tile at (%1,%2) on layer '%3'")
-                               .arg(x + 1).arg(y + 1).arg(tileLayer->name()));
-                return;
+    // The data is base64 decoded and inflated in fixed size chunks straight
+    // into the layer, rather than materializing the decoded and uncompressed
+    // data in full first.
+    enum { BlockSize = 1024, InputSize = 16 * 1024 };
+    char bytes[BlockSize * 4];
+    char input[InputSize];
+    unsigned gids[BlockSize];
+    Cell cells[BlockSize];
+
+    Base64Decoder base64(mData);
+    Inflater inflater;
+
+    const int tileCount = mTileLayer->width() * mTileLayer->height();
+    int index = 0;
+
+    for (;;) {
+        int filled = 0;
+
+        if (compressed) {
+            while (filled < int(sizeof(bytes)) && !inflater.atEnd()) {
+                if (inflater.needsInput()) {
+                    if (base64.atEnd())
+                        break;
+
+                    inflater.setInput(input, base64.decode(input, InputSize));
+                    continue;
+                }
+
+                const int inflated = inflater.inflate(bytes + filled,
+                                                      sizeof(bytes) - filled);
+                if (inflated == -1) {
+                    mError = tr("Corrupt layer data for layer '%1'")
+                            .arg(mTileLayer->name());
+                    return;
+                }
+                filled += inflated;
             }
-            tileLayer->setCell(x, y, cellForGid(gid));
+        } else {
+            filled = base64.decode(bytes, sizeof(bytes));
+        }
+
+        if (filled == 0)
+            break;
+
+        const int count = filled / 4;
+        if (filled % 4 != 0 || count > tileCount - index) {
+            mError = tr("Corrupt layer data for layer '%1'")
+                    .arg(mTileLayer->name());
+            return;
+        }
+
+        const uchar *data = reinterpret_cast<const uchar*>(bytes);
+        for (int i = 0; i < count; ++i)
+            gids[i] = qFromLittleEndian<quint32>(data + i * 4);
+
+        if (!cellsForGids(gids, count, cells))
+            return;
+
+        mTileLayer->setCellRange(index, count, cells);
+        index += count;
+    }
+
+    // Like decompress(), refuse any data following the compressed stream.
+    // The leftover input is only decoded to skip trailing whitespace.
+    const bool trailingData = compressed
+            && (!inflater.needsInput() || base64.decode(input, 1) > 0);
+
+    if (index != tileCount || (compressed && !inflater.atEnd())
+            || trailingData) {
+        mError = tr("Corrupt layer data for layer '%1'")
+                .arg(mTileLayer->name());
+    }
+}
+
+static inline bool isCSVSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+void LayerDataDecoder::decodeCSVLayerData()
+{
+    const int width = mTileLayer->width();
+    const int tileCount = width * mTileLayer->height();
+
+    // The text is scanned in a single pass, converting the GIDs in blocks
+    enum { BlockSize = 1024 };
+    unsigned gids[BlockSize];
+    Cell cells[BlockSize];
+
+    const char *c = mData.constData();
+    const char *end = c + mData.size();
+    int index = 0;
+    int count = 0;
+    bool atEnd = false;
+
+    while (!atEnd) {
+        const int position = index + count;
+        if (position == tileCount) {
+            mError = tr("Corrupt layer data for layer '%1'")
+                    .arg(mTileLayer->name());
+            return;
+        }
+
+        while (c != end && isCSVSpace(*c))
+            ++c;
+
+        const char *digits = c;
+        unsigned gid = 0;
+        bool overflow = false;
+
+        while (c != end && *c >= '0' && *c <= '9') {
+            const unsigned digit = *c - '0';
+            if (gid > (0xFFFFFFFFu - digit) / 10)
+                overflow = true;
+            gid = gid * 10 + digit;
+            ++c;
+        }
+
+        const bool hasDigits = c != digits;
+
+        while (c != end && isCSVSpace(*c))
+            ++c;
+
+        if (!hasDigits || overflow || (c != end && *c != ',')) {
+            mError = tr("Unable to parse tile at (%1,%2) on layer '%3'")
+                    .arg(position % width + 1).arg(position / width + 1)
+                    .arg(mTileLayer->name());
+            return;
+        }
+
+        gids[count++] = gid;
+
+        if (c == end)
+            atEnd = true;
+        else
+            ++c; // Skip the comma
+
+        if (count == BlockSize || atEnd) {
+            if (!cellsForGids(gids, count, cells))
+                return;
+
+            mTileLayer->setCellRange(index, count, cells);
+            index += count;
+            count = 0;
         }
     }
+
+    if (index != tileCount) {
+        mError = tr("Corrupt layer data for layer '%1'")
+                .arg(mTileLayer->name());
+    }
+}
+
+bool LayerDataDecoder::cellsForGids(const unsigned *gids, int count,
+                                    Cell *cells)
+{
+    const int invalidIndex = mGidMapper.gidsToCells(gids, count, cells);
+    if (invalidIndex == -1)
+        return true;
+
+    if (mGidMapper.isEmpty())
+        mError = tr("Tile used but no tilesets specified");
+    else
+        mError = tr("Invalid tile: %1").arg(gids[invalidIndex]);
+
+    return false;
 }
 
 Cell MapReaderPrivate::cellForGid(unsigned gid)
@@ -907,7 +1323,48 @@ Map *MapReader::readMap(const QString &fileName)
     if (!d->openFile(&file))
         return 0;
 
-    return readMap(&file, QFileInfo(fileName).absolutePath());
+    const QString path = QFileInfo(fileName).absolutePath();
+
+    // Large files are read from a memory mapping, which avoids buffering
+    // them. Smaller files are copied up front, since touching a mapping of
+    // a file that is truncated meanwhile crashes the process. Either way
+    // the layer data can be decoded straight from the file's bytes.
+    const qint64 size = file.size();
+    if (size > INT_MAX)
+        return readMap(&file, path);
+
+    uchar *mapped = 0;
+    if (size >= MappedFileThreshold)
+        mapped = file.map(0, size);
+
+    if (mapped) {
+        d->mMappedData = QByteArray::fromRawData(reinterpret_cast<char*>(mapped),
+                                                 int(size));
+    } else {
+        d->mMappedData = file.readAll();
+        if (file.error() != QFile::NoError) {
+            d->mMappedData = QByteArray();
+            d->mError = MapReaderPrivate::tr("Unable to read file: %1")
+                    .arg(fileName);
+            return 0;
+        }
+    }
+    d->mMappedDataPosition = 0;
+    d->mMappedDataSkew = 0;
+
+    QBuffer buffer;
+    buffer.setData(d->mMappedData);
+    buffer.open(QIODevice::ReadOnly);
+
+    Map *map = readMap(&buffer, path);
+
+    buffer.close();
+    buffer.setData(QByteArray());
+    d->mMappedData = QByteArray();
+    if (mapped)
+        file.unmap(mapped);
+
+    return map;
 }
 
 Tileset *MapReader::readTileset(QIODevice *device, const QString &path)
@@ -933,6 +1390,26 @@ QString MapReader::errorString() const
     return d->errorString();
 }
 
+void MapReader::setParallelDecodingEnabled(bool enabled)
+{
+    d->mParallelDecoding = enabled;
+}
+
+bool MapReader::isParallelDecodingEnabled() const
+{
+    return d->mParallelDecoding;
+}
+
+void MapReader::setTilesetCache(TilesetCache *cache)
+{
+    d->mTilesetCache = cache;
+}
+
+TilesetCache *MapReader::tilesetCache() const
+{
+    return d->mTilesetCache;
+}
+
 QString MapReader::resolveReference(const QString &reference,
                                     const QString &mapPath)
 {
@@ -950,6 +1427,9 @@ QImage MapReader::readExternalImage(const QString &source)
 Tileset *MapReader::readExternalTileset(const QString &source,
                                         QString *error)
 {
+    if (d->mTilesetCache)
+        return d->mTilesetCache->tileset(source, error);
+
     MapReader reader;
 
     Tileset *tileset = reader.readTileset(source);
@@ -39,6 +39,7 @@ namespace Tiled {
 
 class Map;
 class Tileset;
+class TilesetCache;
 
 namespace Internal {
 class MapReaderPrivate;
@@ -95,6 +96,25 @@ public:
      */
     QString errorString() const;
 
+    /**
+     * Sets whether the data of tile layers is decoded in parallel. When
+     * enabled, reading a map only collects the encoded layer data, which is
+     * then decoded on multiple threads before readMap() returns. Enabled by
+     * default.
+     */
+    void setParallelDecodingEnabled(bool enabled);
+    bool isParallelDecodingEnabled() const;
+
+    /**
+     * Sets the \a cache used by the default implementation of
+     * readExternalTileset(). Tilesets returned by the cache are owned by it,
+     * and are not deleted when reading a map fails.
+     *
+     * The cache is not owned by the reader. By default no cache is used.
+     */
+    void setTilesetCache(TilesetCache *cache);
+    TilesetCache *tilesetCache() const;
+
 protected:
     /**
      * Called for each \a reference to an external file. Should return the path
@@ -111,7 +131,8 @@ protected:
 
     /**
      * Called when an external tileset is encountered while a map is loaded.
-     * The default implementation just calls readTileset() on a new MapReader.
+     * The default implementation gets the tileset from the tileset cache
+     * when one is set, and otherwise calls readTileset() on a new MapReader.
      *
      * If an error occurred, the \a error parameter should be set to the error
      * message.
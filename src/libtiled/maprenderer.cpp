@@ -34,6 +34,7 @@
 
 #include <QPainter>
 #include <QVector2D>
+#include <QtCore/qmath.h>
 
 using namespace Tiled;
 
@@ -61,6 +62,70 @@ void MapRenderer::setFlag(RenderFlag flag, bool enabled)
         mFlags &= ~flag;
 }
 
+bool MapRenderer::useLowDetail(const QPainter *painter) const
+{
+    if (mLevelOfDetailThreshold <= 0)
+        return false;
+
+    // The geometric mean of the horizontal and vertical scale
+    const QTransform &transform = painter->worldTransform();
+    const qreal scale = qSqrt(qAbs(transform.determinant()));
+
+    return scale < mLevelOfDetailThreshold;
+}
+
+void MapRenderer::drawTileLayerAtLowDetail(QPainter *painter,
+                                           const TileLayer *layer,
+                                           const QRectF &exposed) const
+{
+    const QTransform transform = painter->worldTransform();
+
+    bool invertible;
+    const QTransform inverted = transform.inverted(&invertible);
+    if (!invertible)
+        return;
+
+    QRectF area = boundingRect(layer->bounds());
+    if (!exposed.isNull())
+        area &= exposed;
+
+    QRect target = transform.mapRect(area).toAlignedRect();
+    if (const QPaintDevice *device = painter->device())
+        target &= QRect(0, 0, device->width(), device->height());
+
+    if (target.isEmpty())
+        return;
+
+    QImage image(target.size(), QImage::Format_ARGB32_Premultiplied);
+
+    for (int y = 0; y < target.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb*>(image.scanLine(y));
+
+        for (int x = 0; x < target.width(); ++x) {
+            // Sample the cell at the center of the device pixel
+            const QPointF pixel(target.x() + x + 0.5,
+                                target.y() + y + 0.5);
+            const QPointF tileCoords = pixelToTileCoords(inverted.map(pixel));
+            const int tileX = qFloor(tileCoords.x()) - layer->x();
+            const int tileY = qFloor(tileCoords.y()) - layer->y();
+
+            QRgb color = 0;
+            if (layer->contains(tileX, tileY)) {
+                const Cell &cell = layer->cellAt(tileX, tileY);
+                if (!cell.isEmpty())
+                    color = cell.tile()->averageColor();
+            }
+
+            line[x] = color;
+        }
+    }
+
+    painter->save();
+    painter->resetTransform();
+    painter->drawImage(target.topLeft(), image);
+    painter->restore();
+}
+
 /**
  * Converts a line running from \a start to \a end to a polygon which
  * extends 5 pixels from the line in all directions.
@@ -94,9 +159,9 @@ void MapRenderer::drawCell(QPainter *painter,
                            Origin origin,
                            const QTransform &baseTransform)
 {
-    const QPixmap &img = cell.tile->image();
-    const QPoint offset = cell.tile->tileset()->tileOffset();
-    const QSize imgSize = img.size();
+    const Tile *tile = cell.tile();
+    const QPoint offset = tile->tileset()->tileOffset();
+    const QSize imgSize = tile->size();
 
     qreal m11 = 1;      // Horizontal scaling factor
     qreal m12 = 0;      // Vertical shearing factor
@@ -108,7 +173,7 @@ void MapRenderer::drawCell(QPainter *painter,
     if (origin == BottomCenter)
         dx += -imgSize.width() / 2;
 
-    if (cell.flippedAntiDiagonally) {
+    if (cell.flippedAntiDiagonally()) {
         // Use shearing to swap the X/Y axis
         m11 = 0;
         m12 = 1;
@@ -120,18 +185,104 @@ void MapRenderer::drawCell(QPainter *painter,
         if (origin == BottomCenter)
             dx += (imgSize.width() - imgSize.height()) / 2;
     }
-    if (cell.flippedHorizontally) {
+    if (cell.flippedHorizontally()) {
         m11 = -m11;
         m21 = -m21;
-        dx += cell.flippedAntiDiagonally ? imgSize.height() : imgSize.width();
+        dx += cell.flippedAntiDiagonally() ? imgSize.height() : imgSize.width();
     }
-    if (cell.flippedVertically) {
+    if (cell.flippedVertically()) {
         m12 = -m12;
         m22 = -m22;
-        dy += cell.flippedAntiDiagonally ? imgSize.width() : imgSize.height();
+        dy += cell.flippedAntiDiagonally() ? imgSize.width() : imgSize.height();
     }
 
     const QTransform transform(m11, m12, m21, m22, dx, dy);
     painter->setTransform(transform * baseTransform);
-    painter->drawPixmap(QPointF(), img);
+    painter->drawPixmap(QPointF(), tile->atlasImage(), tile->imageRect());
+}
+
+
+CellRenderer::CellRenderer(QPainter *painter)
+    : mPainter(painter)
+#if QT_VERSION < 0x040700
+    , mBaseTransform(painter->transform())
+#endif
+{
+}
+
+CellRenderer::~CellRenderer()
+{
+    flush();
+}
+
+void CellRenderer::render(const Cell &cell, const QPointF &pos,
+                          MapRenderer::Origin origin)
+{
+#if QT_VERSION >= 0x040700
+    const Tile *tile = cell.tile();
+    const QPixmap &atlas = tile->atlasImage();
+
+    if (atlas.cacheKey() != mAtlas.cacheKey()) {
+        flush();
+        mAtlas = atlas;
+    }
+
+    const QPoint offset = tile->tileset()->tileOffset();
+    const QRect sourceRect = tile->imageRect();
+
+    // The size the tile occupies on the map, after swapping the X/Y axis
+    const int width = cell.flippedAntiDiagonally() ? sourceRect.height()
+                                                   : sourceRect.width();
+    const int height = cell.flippedAntiDiagonally() ? sourceRect.width()
+                                                    : sourceRect.height();
+
+    qreal left = offset.x() + pos.x();
+    const qreal bottom = offset.y() + pos.y();
+
+    // Offset the same way as drawCell, which rounds both terms separately
+    if (origin == MapRenderer::BottomCenter) {
+        left -= sourceRect.width() / 2;
+        if (cell.flippedAntiDiagonally())
+            left += (sourceRect.width() - sourceRect.height()) / 2;
+    }
+
+    // Fragments are positioned by their center and transformed around it
+    const QPointF center(left + width / qreal(2),
+                         bottom - height / qreal(2));
+
+    const qreal flipX = cell.flippedHorizontally() ? -1 : 1;
+    const qreal flipY = cell.flippedVertically() ? -1 : 1;
+
+    qreal scaleX = flipX;
+    qreal scaleY = flipY;
+    qreal rotation = 0;
+
+    if (cell.flippedAntiDiagonally()) {
+        // Swapping the X/Y axis is a quarter rotation plus a mirror
+        scaleX = flipY;
+        scaleY = -flipX;
+        rotation = 90;
+    }
+
+    mFragments.append(QPainter::PixmapFragment::create(center, sourceRect,
+                                                       scaleX, scaleY,
+                                                       rotation));
+#else
+    MapRenderer::drawCell(mPainter, cell, pos, origin, mBaseTransform);
+#endif
+}
+
+void CellRenderer::flush()
+{
+#if QT_VERSION >= 0x040700
+    if (mFragments.isEmpty())
+        return;
+
+    mPainter->drawPixmapFragments(mFragments.constData(),
+                                  mFragments.size(),
+                                  mAtlas);
+    mFragments.resize(0);
+#else
+    mPainter->setTransform(mBaseTransform);
+#endif
 }
@@ -32,6 +32,8 @@
 #include "tiled_global.h"
 
 #include <QPainter>
+#include <QPixmap>
+#include <QVector>
 
 namespace Tiled {
 
@@ -56,7 +58,10 @@ Q_DECLARE_FLAGS(RenderFlags, RenderFlag)
 class TILEDSHARED_EXPORT MapRenderer
 {
 public:
-    MapRenderer(const Map *map) : mMap(map) {}
+    MapRenderer(const Map *map)
+        : mMap(map)
+        , mLevelOfDetailThreshold(0)
+    {}
     virtual ~MapRenderer() {}
 
     /**
@@ -164,6 +169,21 @@ public:
     RenderFlags flags() const { return mFlags; }
     void setFlags(RenderFlags flags) { mFlags = flags; }
 
+    /**
+     * Returns the scale below which tile layers are drawn at a low level of
+     * detail, using only the average color of each tile. The default of 0
+     * means tile layers are always drawn in full detail.
+     */
+    qreal levelOfDetailThreshold() const { return mLevelOfDetailThreshold; }
+
+    /**
+     * Sets the scale below which tile layers are drawn at a low level of
+     * detail. Drawing many tiles at sub-pixel size is very slow, while at
+     * such scales the individual tiles can't be made out anyway.
+     */
+    void setLevelOfDetailThreshold(qreal scale)
+    { mLevelOfDetailThreshold = scale; }
+
     static QPolygonF lineToPolygon(const QPointF &start, const QPointF &end);
 
     enum Origin {
@@ -182,10 +202,72 @@ protected:
      */
     const Map *map() const { return mMap; }
 
+    /**
+     * Returns whether tile layers drawn with the given \a painter should be
+     * drawn at a low level of detail.
+     *
+     * @see drawTileLayerAtLowDetail()
+     */
+    bool useLowDetail(const QPainter *painter) const;
+
+    /**
+     * Draws the given tile \a layer at a low level of detail, by sampling the
+     * cell under each device pixel and filling that pixel with the average
+     * color of its tile. This way each pixel is touched only once, no matter
+     * how many tiles are visible.
+     *
+     * Tile offsets and tiles larger than the grid are not taken into account.
+     */
+    void drawTileLayerAtLowDetail(QPainter *painter,
+                                  const TileLayer *layer,
+                                  const QRectF &exposed) const;
+
 private:
     const Map *mMap;
 
     RenderFlags mFlags;
+    qreal mLevelOfDetailThreshold;
+};
+
+/**
+ * A utility class for drawing many cells in a row.
+ *
+ * Consecutive cells that share the same source image are collected and
+ * drawn in one go using QPainter::drawPixmapFragments, which avoids setting
+ * up a transform for every single tile. The drawing order is preserved,
+ * since a batch is flushed as soon as a cell uses a different image.
+ *
+ * The painter transform is left untouched. Cells are drawn at the latest
+ * when the CellRenderer is destroyed.
+ */
+class TILEDSHARED_EXPORT CellRenderer
+{
+public:
+    explicit CellRenderer(QPainter *painter);
+    ~CellRenderer();
+
+    /**
+     * Queues the \a cell for drawing with the given \a origin at \a pos,
+     * taking into account the flipping and tile offset.
+     */
+    void render(const Cell &cell, const QPointF &pos,
+                MapRenderer::Origin origin);
+
+    /**
+     * Draws all the cells that are still queued.
+     */
+    void flush();
+
+private:
+    Q_DISABLE_COPY(CellRenderer)
+
+    QPainter * const mPainter;
+#if QT_VERSION >= 0x040700
+    QPixmap mAtlas;
+    QVector<QPainter::PixmapFragment> mFragments;
+#else
+    const QTransform mBaseTransform;
+#endif
 };
 
 } // namespace Tiled
@@ -44,6 +44,8 @@
 #include <QCoreApplication>
 #include <QBuffer>
 #include <QDir>
+#include <QRunnable>
+#include <QThreadPool>
 #include <QXmlStreamWriter>
 
 using namespace Tiled;
@@ -52,6 +54,42 @@ using namespace Tiled::Internal;
 namespace Tiled {
 namespace Internal {
 
+/**
+ * Encodes the data of a tile layer in CSV or (compressed) base64 format.
+ *
+ * Since it only reads from the tile layer and the GidMapper, encoders for
+ * different layers can run in parallel on a QThreadPool.
+ */
+class LayerDataEncoder : public QRunnable
+{
+public:
+    LayerDataEncoder(const TileLayer *tileLayer,
+                     const GidMapper &gidMapper,
+                     Map::LayerDataFormat format,
+                     CompressionLevel compressionLevel)
+        : mTileLayer(tileLayer)
+        , mGidMapper(gidMapper)
+        , mFormat(format)
+        , mCompressionLevel(compressionLevel)
+    {}
+
+    void run();
+
+    const TileLayer *tileLayer() const { return mTileLayer; }
+
+    /**
+     * Returns the encoded layer data. Only valid after run() was called.
+     */
+    const QString &encodedData() const { return mEncodedData; }
+
+private:
+    const TileLayer *mTileLayer;
+    const GidMapper &mGidMapper;
+    const Map::LayerDataFormat mFormat;
+    const CompressionLevel mCompressionLevel;
+    QString mEncodedData;
+};
+
 class MapWriterPrivate
 {
     Q_DECLARE_TR_FUNCTIONS(MapReader)
@@ -69,12 +107,16 @@ public:
 
     QString mError;
     Map::LayerDataFormat mLayerDataFormat;
+    CompressionLevel mCompressionLevel;
     bool mDtdEnabled;
+    bool mParallelEncoding;
 
 private:
     void writeMap(QXmlStreamWriter &w, const Map *map);
     void writeTileset(QXmlStreamWriter &w, const Tileset *tileset,
                       unsigned firstGid);
+    void encodeLayerData(const Map *map);
+    QString takeEncodedLayerData(const TileLayer *tileLayer);
     void writeTileLayer(QXmlStreamWriter &w, const TileLayer *tileLayer);
     void writeLayerAttributes(QXmlStreamWriter &w, const Layer *layer);
     void writeObjectGroup(QXmlStreamWriter &w, const ObjectGroup *objectGroup);
@@ -85,6 +127,7 @@ private:
 
     QDir mMapDir;     // The directory in which the map is being saved
     GidMapper mGidMapper;
+    QHash<const TileLayer*, QString> mEncodedLayerData;
     bool mUseAbsolutePaths;
 };
 
@@ -94,7 +137,9 @@ private:
 
 MapWriterPrivate::MapWriterPrivate()
     : mLayerDataFormat(Map::Base64Zlib)
+    , mCompressionLevel(DefaultCompression)
     , mDtdEnabled(false)
+    , mParallelEncoding(true)
     , mUseAbsolutePaths(false)
 {
 }
@@ -187,6 +232,8 @@ void MapWriterPrivate::writeMap(QXmlStreamWriter &w, const Map *map)
         firstGid += tileset->tileCount();
     }
 
+    encodeLayerData(map);
+
     foreach (const Layer *layer, map->layers()) {
         const Layer::Type type = layer->type();
         if (type == Layer::TileLayerType)
@@ -197,9 +244,71 @@ void MapWriterPrivate::writeMap(QXmlStreamWriter &w, const Map *map)
             writeImageLayer(w, static_cast<const ImageLayer*>(layer));
     }
 
+    mEncodedLayerData.clear();
+
     w.writeEndElement();
 }
 
+/**
+ * Encodes the data of all tile layers of the \a map up front in parallel,
+ * when enabled and there is more than one tile layer. The results are stored
+ * in mEncodedLayerData. Otherwise, each layer is encoded when it is written,
+ * so that only one encoded layer is held in memory at a time.
+ */
+void MapWriterPrivate::encodeLayerData(const Map *map)
+{
+    mEncodedLayerData.clear();
+
+    if (!mParallelEncoding || mLayerDataFormat == Map::XML)
+        return;
+
+    QList<LayerDataEncoder*> encoders;
+    foreach (const Layer *layer, map->layers()) {
+        if (layer->type() == Layer::TileLayerType) {
+            const TileLayer *tileLayer = static_cast<const TileLayer*>(layer);
+            encoders.append(new LayerDataEncoder(tileLayer, mGidMapper,
+                                                 mLayerDataFormat,
+                                                 mCompressionLevel));
+        }
+    }
+
+    if (encoders.size() > 1) {
+        // Not the global pool, since writing may itself run in one of its
+        // threads and waitForDone() would then also wait for unrelated jobs
+        QThreadPool threadPool;
+
+        foreach (LayerDataEncoder *encoder, encoders) {
+            encoder->setAutoDelete(false);
+            threadPool.start(encoder);
+        }
+
+        threadPool.waitForDone();
+
+        foreach (const LayerDataEncoder *encoder, encoders) {
+            mEncodedLayerData.insert(encoder->tileLayer(),
+                                     encoder->encodedData());
+        }
+    }
+
+    qDeleteAll(encoders);
+}
+
+/**
+ * Returns the encoded data of the \a tileLayer, removing it from
+ * mEncodedLayerData so that it is freed once written. Layers that were not
+ * encoded up front are encoded now.
+ */
+QString MapWriterPrivate::takeEncodedLayerData(const TileLayer *tileLayer)
+{
+    if (mEncodedLayerData.contains(tileLayer))
+        return mEncodedLayerData.take(tileLayer);
+
+    LayerDataEncoder encoder(tileLayer, mGidMapper,
+                             mLayerDataFormat, mCompressionLevel);
+    encoder.run();
+    return encoder.encodedData();
+}
+
 static QString makeTerrainAttribute(const Tile *tile)
 {
     QString terrain;
@@ -376,42 +485,11 @@ void MapWriterPrivate::writeTileLayer(QXmlStreamWriter &w,
             }
         }
     } else if (mLayerDataFormat == Map::CSV) {
-        QString tileData;
-
-        for (int y = 0; y < tileLayer->height(); ++y) {
-            for (int x = 0; x < tileLayer->width(); ++x) {
-                const unsigned gid = mGidMapper.cellToGid(tileLayer->cellAt(x, y));
-                tileData.append(QString::number(gid));
-                if (x != tileLayer->width() - 1
-                    || y != tileLayer->height() - 1)
-                    tileData.append(QLatin1String(","));
-            }
-            tileData.append(QLatin1String("\n"));
-        }
-
         w.writeCharacters(QLatin1String("\n"));
-        w.writeCharacters(tileData);
+        w.writeCharacters(takeEncodedLayerData(tileLayer));
     } else {
-        QByteArray tileData;
-        tileData.reserve(tileLayer->height() * tileLayer->width() * 4);
-
-        for (int y = 0; y < tileLayer->height(); ++y) {
-            for (int x = 0; x < tileLayer->width(); ++x) {
-                const unsigned gid = mGidMapper.cellToGid(tileLayer->cellAt(x, y));
-                tileData.append((char) (gid));
-                tileData.append((char) (gid >> 8));
-                tileData.append((char) (gid >> 16));
-                tileData.append((char) (gid >> 24));
-            }
-        }
-
-        if (mLayerDataFormat == Map::Base64Gzip)
-            tileData = compress(tileData, Gzip);
-        else if (mLayerDataFormat == Map::Base64Zlib)
-            tileData = compress(tileData, Zlib);
-
         w.writeCharacters(QLatin1String("\n   "));
-        w.writeCharacters(QString::fromLatin1(tileData.toBase64()));
+        w.writeCharacters(takeEncodedLayerData(tileLayer));
         w.writeCharacters(QLatin1String("\n  "));
     }
 
@@ -604,6 +682,61 @@ void MapWriterPrivate::writeProperties(QXmlStreamWriter &w,
 }
 
 
+void LayerDataEncoder::run()
+{
+    if (mFormat == Map::CSV) {
+        const int width = mTileLayer->width();
+        const int height = mTileLayer->height();
+
+        // Formatting the numbers by hand avoids allocating a string per tile
+        QByteArray tileData;
+        tileData.reserve(width * height * 2 + height);
+
+        char number[10];
+
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                unsigned gid = mGidMapper.cellToGid(mTileLayer->cellAt(x, y));
+
+                char *digit = number + sizeof(number);
+                do {
+                    *--digit = char('0' + gid % 10);
+                    gid /= 10;
+                } while (gid != 0);
+
+                tileData.append(digit, number + sizeof(number) - digit);
+                if (x != width - 1 || y != height - 1)
+                    tileData.append(',');
+            }
+            tileData.append('\n');
+        }
+
+        mEncodedData = QString::fromLatin1(tileData.constData(),
+                                           tileData.size());
+    } else {
+        QByteArray tileData;
+        tileData.reserve(mTileLayer->height() * mTileLayer->width() * 4);
+
+        for (int y = 0; y < mTileLayer->height(); ++y) {
+            for (int x = 0; x < mTileLayer->width(); ++x) {
+                const unsigned gid = mGidMapper.cellToGid(mTileLayer->cellAt(x, y));
+                tileData.append((char) (gid));
+                tileData.append((char) (gid >> 8));
+                tileData.append((char) (gid >> 16));
+                tileData.append((char) (gid >> 24));
+            }
+        }
+
+        if (mFormat == Map::Base64Gzip)
+            tileData = compress(tileData, Gzip, mCompressionLevel);
+        else if (mFormat == Map::Base64Zlib)
+            tileData = compress(tileData, Zlib, mCompressionLevel);
+
+        mEncodedData = QString::fromLatin1(tileData.toBase64());
+    }
+}
+
+
 MapWriter::MapWriter()
     : d(new MapWriterPrivate)
 {
@@ -673,6 +806,16 @@ Map::LayerDataFormat MapWriter::layerDataFormat() const
     return d->mLayerDataFormat;
 }
 
+void MapWriter::setCompressionLevel(CompressionLevel level)
+{
+    d->mCompressionLevel = level;
+}
+
+CompressionLevel MapWriter::compressionLevel() const
+{
+    return d->mCompressionLevel;
+}
+
 void MapWriter::setDtdEnabled(bool enabled)
 {
     d->mDtdEnabled = enabled;
@@ -682,3 +825,13 @@ bool MapWriter::isDtdEnabled() const
 {
     return d->mDtdEnabled;
 }
+
+void MapWriter::setParallelEncodingEnabled(bool enabled)
+{
+    d->mParallelEncoding = enabled;
+}
+
+bool MapWriter::isParallelEncodingEnabled() const
+{
+    return d->mParallelEncoding;
+}
@@ -30,6 +30,7 @@
 #ifndef MAPWRITER_H
 #define MAPWRITER_H
 
+#include "compression.h"
 #include "map.h"
 #include "tiled_global.h"
 
@@ -104,12 +105,26 @@ public:
     void setLayerDataFormat(Map::LayerDataFormat format);
     Map::LayerDataFormat layerDataFormat() const;
 
+    /**
+     * Sets the compression level used for the Base64Gzip and Base64Zlib
+     * layer data formats. Defaults to DefaultCompression.
+     */
+    void setCompressionLevel(CompressionLevel level);
+    CompressionLevel compressionLevel() const;
+
     /**
      * Sets whether the DTD reference is written when saving the map.
      */
     void setDtdEnabled(bool enabled);
     bool isDtdEnabled() const;
 
+    /**
+     * Sets whether the data of tile layers is encoded and compressed in
+     * parallel before the map is written. Enabled by default.
+     */
+    void setParallelEncodingEnabled(bool enabled);
+    bool isParallelEncodingEnabled() const;
+
 private:
     Internal::MapWriterPrivate *d;
 };
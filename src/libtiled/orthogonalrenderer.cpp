@@ -65,8 +65,8 @@ QRectF OrthogonalRenderer::boundingRect(const MapObject *object) const
 
     if (!object->cell().isEmpty()) {
         const QPointF bottomLeft = rect.topLeft();
-        const Tile *tile = object->cell().tile;
-        const QSize imgSize = tile->image().size();
+        const Tile *tile = object->cell().tile();
+        const QSize imgSize = tile->size();
         const QPoint tileOffset = tile->tileset()->tileOffset();
         boundingRect = QRectF(bottomLeft.x() + tileOffset.x(),
                               bottomLeft.y() + tileOffset.y() - imgSize.height(),
@@ -193,6 +193,11 @@ void OrthogonalRenderer::drawTileLayer(QPainter *painter,
                                        const TileLayer *layer,
                                        const QRectF &exposed) const
 {
+    if (useLowDetail(painter)) {
+        drawTileLayerAtLowDetail(painter, layer, exposed);
+        return;
+    }
+
     QTransform savedTransform = painter->transform();
 
     const int tileWidth = map()->tileWidth();
@@ -225,7 +230,7 @@ void OrthogonalRenderer::drawTileLayer(QPainter *painter,
         endY = qMin((int) std::ceil(rect.bottom()) / tileHeight + 1, endY);
     }
 
-    QTransform baseTransform = painter->transform();
+    CellRenderer renderer(painter);
 
     for (int y = startY; y < endY; ++y) {
         for (int x = startX; x < endX; ++x) {
@@ -233,13 +238,14 @@ void OrthogonalRenderer::drawTileLayer(QPainter *painter,
             if (cell.isEmpty())
                 continue;
 
-            drawCell(painter, cell,
-                     QPointF(x * tileWidth, (y + 1) * tileHeight),
-                     BottomLeft,
-                     baseTransform);
+            renderer.render(cell,
+                            QPointF(x * tileWidth, (y + 1) * tileHeight),
+                            BottomLeft);
         }
     }
 
+    renderer.flush();
+
     painter->setTransform(savedTransform);
 }
 
@@ -277,7 +283,7 @@ void OrthogonalRenderer::drawMapObject(QPainter *painter,
                  painter->transform());
 
         if (testFlag(ShowTileObjectOutlines)) {
-            const QRect rect = cell.tile->image().rect();
+            const QRect rect(QPoint(), cell.tile()->size());
             QPen pen(Qt::SolidLine);
             pen.setWidth(0);
             painter->setPen(pen);
@@ -35,7 +35,6 @@
 #include <QColor>
 #include <QMetaType>
 #include <QString>
-#include <QVector>
 
 namespace Tiled {
 
@@ -99,24 +98,14 @@ public:
     /**
      * Returns the transition penalty(/distance) from this terrain type to another terrain type.
      */
-    int transitionDistance(int targetTerrainType) const { return mTransitionDistance[targetTerrainType + 1]; }
-
-    /**
-     * Sets the transition penalty(/distance) from this terrain type to another terrain type.
-     */
-    void setTransitionDistance(int targetTerrainType, int distance) { mTransitionDistance[targetTerrainType + 1] = distance; }
-
-    /**
-     * Returns the array of terrain penalties(/distances).
-     */
-    void setTransitionDistances(const QVector<int> &transitionDistances) { mTransitionDistance = transitionDistances; }
+    int transitionDistance(int targetTerrainType) const
+    { return mTileset->terrainTransitionPenalty(mId, targetTerrainType); }
 
 private:
     int mId;
     Tileset *mTileset;
     QString mName;
     int mImageTileId;
-    QVector<int> mTransitionDistance;
 };
 
 } // namespace Tiled
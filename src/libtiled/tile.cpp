@@ -45,3 +45,49 @@ void Tile::setTerrain(unsigned terrain)
     mTerrain = terrain;
     mTileset->markTerrainDistancesDirty();
 }
+
+QRgb Tile::computeAverageColor(const QImage &image,
+                               const QRect &rect,
+                               const QColor &transparentColor)
+{
+    const QRect area = rect & image.rect();
+    if (area.isEmpty())
+        return 0;
+
+    const bool convert = image.format() != QImage::Format_ARGB32;
+    const QImage source = convert ? image.copy(area).convertToFormat(
+                                        QImage::Format_ARGB32)
+                                  : image;
+    const QRect sourceRect = convert ? QRect(QPoint(), area.size()) : area;
+
+    const bool useTransparentColor = transparentColor.isValid();
+    const QRgb transparent = transparentColor.rgb() & RGB_MASK;
+
+    quint64 red = 0;
+    quint64 green = 0;
+    quint64 blue = 0;
+    quint64 alpha = 0;
+
+    for (int y = sourceRect.top(); y <= sourceRect.bottom(); ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(source.scanLine(y));
+
+        for (int x = sourceRect.left(); x <= sourceRect.right(); ++x) {
+            const QRgb pixel = line[x];
+            if (useTransparentColor && (pixel & RGB_MASK) == transparent)
+                continue;
+
+            const int a = qAlpha(pixel);
+            red += qRed(pixel) * a;
+            green += qGreen(pixel) * a;
+            blue += qBlue(pixel) * a;
+            alpha += a;
+        }
+    }
+
+    const quint64 count = quint64(area.width()) * area.height();
+
+    return qRgba(int(red / (count * 255)),
+                 int(green / (count * 255)),
+                 int(blue / (count * 255)),
+                 int(alpha / count));
+}
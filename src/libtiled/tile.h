@@ -32,6 +32,7 @@
 
 #include "object.h"
 
+#include <QImage>
 #include <QPixmap>
 
 namespace Tiled {
@@ -52,10 +53,32 @@ inline unsigned setTerrainCorner(unsigned terrain, int corner, int terrainId)
 class TILEDSHARED_EXPORT Tile : public Object
 {
 public:
+    /**
+     * Constructs a tile with the given \a image. Its average color is left
+     * transparent, since it is cheaper to compute from the source image.
+     *
+     * @see setAverageColor()
+     */
     Tile(const QPixmap &image, int id, Tileset *tileset):
         mId(id),
         mTileset(tileset),
         mImage(image),
+        mImageRect(image.rect()),
+        mAverageColor(0),
+        mTerrain(-1),
+        mTerrainProbability(-1.f)
+    {}
+
+    /**
+     * Constructs a tile whose image is the \a rect part of the \a atlas
+     * image, which is usually shared with the other tiles of the tileset.
+     */
+    Tile(const QPixmap &atlas, const QRect &rect, int id, Tileset *tileset):
+        mId(id),
+        mTileset(tileset),
+        mImage(atlas),
+        mImageRect(rect),
+        mAverageColor(0),
         mTerrain(-1),
         mTerrainProbability(-1.f)
     {}
@@ -71,29 +94,92 @@ public:
     Tileset *tileset() const { return mTileset; }
 
     /**
-     * Returns the image of this tile.
+     * Returns the image of this tile. When the tile is part of an atlas,
+     * a copy of its part of the atlas is made on first use and kept until
+     * the image changes. For drawing, atlasImage() and imageRect() should
+     * be used instead.
+     */
+    QPixmap image() const
+    {
+        if (mImageRect == mImage.rect())
+            return mImage;
+        if (mImageCopy.isNull())
+            mImageCopy = mImage.copy(mImageRect);
+        return mImageCopy;
+    }
+
+    /**
+     * Returns the image that contains the image of this tile, which may be
+     * shared with other tiles.
      */
-    const QPixmap &image() const { return mImage; }
+    const QPixmap &atlasImage() const { return mImage; }
+
+    /**
+     * Returns the location of the image of this tile within atlasImage().
+     */
+    const QRect &imageRect() const { return mImageRect; }
+
+    /**
+     * Sets the image of this tile. The average color is reset to transparent,
+     * since it is cheaper to compute from the source image.
+     *
+     * @see setAverageColor()
+     */
+    void setImage(const QPixmap &image)
+    {
+        mImage = image;
+        mImageRect = image.rect();
+        mImageCopy = QPixmap();
+        mAverageColor = 0;
+    }
+
+    /**
+     * Sets the image of this tile to the \a rect part of the \a atlas image.
+     *
+     * The average color is not updated, since it is cheaper to compute it
+     * for all tiles at once from the source image.
+     *
+     * @see setAverageColor()
+     */
+    void setImage(const QPixmap &atlas, const QRect &rect)
+    {
+        mImage = atlas;
+        mImageRect = rect;
+        mImageCopy = QPixmap();
+    }
+
+    /**
+     * Returns the average color of the image of this tile, as a premultiplied
+     * ARGB value. It is used to draw the tile when it is too small to make
+     * out any of its details.
+     */
+    QRgb averageColor() const { return mAverageColor; }
+
+    void setAverageColor(QRgb color) { mAverageColor = color; }
 
     /**
-     * Sets the image of this tile.
+     * Computes the average color of the \a rect part of \a image, as a
+     * premultiplied ARGB value. When \a transparentColor is valid, pixels of
+     * this color are considered fully transparent.
      */
-    void setImage(const QPixmap &image) { mImage = image; }
+    static QRgb computeAverageColor(const QImage &image,
+                                    const QRect &rect,
+                                    const QColor &transparentColor = QColor());
 
     /**
      * Returns the width of this tile.
      */
-    int width() const { return mImage.width(); }
+    int width() const { return mImageRect.width(); }
 
     /**
      * Returns the height of this tile.
      */
-    int height() const { return mImage.height(); }
+    int height() const { return mImageRect.height(); }
 
     /**
      * Returns the size of this tile.
      */
-    QSize size() const { return mImage.size(); }
+    QSize size() const { return mImageRect.size(); }
 
     /**
      * Returns the Terrain of a given corner.
@@ -135,6 +221,9 @@ private:
     int mId;
     Tileset *mTileset;
     QPixmap mImage;
+    QRect mImageRect;
+    mutable QPixmap mImageCopy;     // Copy of the image, when in an atlas
+    QRgb mAverageColor;
     unsigned mTerrain;
     float mTerrainProbability;
 };
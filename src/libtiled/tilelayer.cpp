@@ -33,31 +33,152 @@
 #include "tile.h"
 #include "tileset.h"
 
+#include <algorithm>
+
 using namespace Tiled;
 
+// Layers with more cells than this use chunked storage by default
+static const int ChunkedStorageThreshold = 1024 * 1024;
+
 TileLayer::TileLayer(const QString &name, int x, int y, int width, int height):
     Layer(TileLayerType, name, x, y, width, height),
     mMaxTileSize(0, 0),
-    mGrid(width * height)
+    mStorage(width * height > ChunkedStorageThreshold ? ChunkedStorage
+                                                      : DenseStorage),
+    mChunkColumns(0)
 {
     Q_ASSERT(width >= 0);
     Q_ASSERT(height >= 0);
+
+    resetStorage(width, height, mStorage);
+}
+
+void TileLayer::setStorage(Storage storage)
+{
+    if (mStorage == storage)
+        return;
+
+    TileLayer newLayer(QString(), 0, 0, 0, 0);
+    newLayer.resetStorage(mWidth, mHeight, storage);
+
+    foreach (const QRect &rect, storedRects()) {
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            for (int x = rect.left(); x <= rect.right(); ++x) {
+                const Cell &cell = cellAt(x, y);
+                if (!cell.isEmpty())
+                    newLayer.cellRef(x, y) = cell;
+            }
+        }
+    }
+
+    takeStorage(newLayer);
+}
+
+const Cell &TileLayer::chunkedCellAt(int x, int y) const
+{
+    static const Cell emptyCell;
+
+    const int chunkIndex = (x >> ChunkBits) + (y >> ChunkBits) * mChunkColumns;
+    const QVector<Cell> &chunk = mChunks.at(chunkIndex);
+    if (chunk.isEmpty())
+        return emptyCell;
+
+    return chunk.at((x & ChunkMask) + (y & ChunkMask) * ChunkSize);
+}
+
+Cell &TileLayer::cellRef(int x, int y)
+{
+    if (mStorage == DenseStorage)
+        return mGrid[x + y * mWidth];
+
+    const int chunkIndex = (x >> ChunkBits) + (y >> ChunkBits) * mChunkColumns;
+    QVector<Cell> &chunk = mChunks[chunkIndex];
+    if (chunk.isEmpty())
+        chunk.resize(ChunkSize * ChunkSize);
+
+    return chunk[(x & ChunkMask) + (y & ChunkMask) * ChunkSize];
+}
+
+QVector<QRect> TileLayer::storedRects() const
+{
+    QVector<QRect> rects;
+
+    if (mWidth == 0 || mHeight == 0)
+        return rects;
+
+    if (mStorage == DenseStorage) {
+        rects.append(QRect(0, 0, mWidth, mHeight));
+        return rects;
+    }
+
+    const QRect layerRect(0, 0, mWidth, mHeight);
+
+    for (int i = 0, i_end = mChunks.size(); i < i_end; ++i) {
+        if (mChunks.at(i).isEmpty())
+            continue;
+
+        const QRect chunkRect = QRect((i % mChunkColumns) * ChunkSize,
+                                      (i / mChunkColumns) * ChunkSize,
+                                      ChunkSize, ChunkSize) & layerRect;
+
+        // Merge horizontally adjacent chunks
+        if (!rects.isEmpty()) {
+            QRect &last = rects.last();
+            if (last.top() == chunkRect.top()
+                    && last.right() + 1 == chunkRect.left()) {
+                last.setRight(chunkRect.right());
+                continue;
+            }
+        }
+
+        rects.append(chunkRect);
+    }
+
+    return rects;
+}
+
+void TileLayer::resetStorage(int width, int height, Storage storage)
+{
+    mWidth = width;
+    mHeight = height;
+    mStorage = storage;
+
+    if (mStorage == DenseStorage) {
+        mGrid = QVector<Cell>(width * height);
+        mChunks.clear();
+        mChunkColumns = 0;
+    } else {
+        const int chunkRows = (height + ChunkMask) >> ChunkBits;
+        mChunkColumns = (width + ChunkMask) >> ChunkBits;
+        mChunks = QVector<QVector<Cell> >(mChunkColumns * chunkRows);
+        mGrid.clear();
+    }
+}
+
+void TileLayer::takeStorage(TileLayer &other)
+{
+    mStorage = other.mStorage;
+    mGrid = other.mGrid;
+    mChunks = other.mChunks;
+    mChunkColumns = other.mChunkColumns;
 }
 
 QRegion TileLayer::region() const
 {
     QRegion region;
 
-    for (int y = 0; y < mHeight; ++y) {
-        for (int x = 0; x < mWidth; ++x) {
-            if (!cellAt(x, y).isEmpty()) {
-                const int rangeStart = x;
-                for (++x; x <= mWidth; ++x) {
-                    if (x == mWidth || cellAt(x, y).isEmpty()) {
-                        const int rangeEnd = x;
-                        region += QRect(rangeStart + mX, y + mY,
-                                        rangeEnd - rangeStart, 1);
-                        break;
+    foreach (const QRect &rect, storedRects()) {
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            for (int x = rect.left(); x <= rect.right(); ++x) {
+                if (!cellAt(x, y).isEmpty()) {
+                    const int rangeStart = x;
+                    for (++x; x <= rect.right() + 1; ++x) {
+                        if (x == rect.right() + 1 || cellAt(x, y).isEmpty()) {
+                            const int rangeEnd = x;
+                            region += QRect(rangeStart + mX, y + mY,
+                                            rangeEnd - rangeStart, 1);
+                            break;
+                        }
                     }
                 }
             }
@@ -83,30 +204,85 @@ static QMargins maxMargins(const QMargins &a,
                     qMax(a.bottom(), b.bottom()));
 }
 
-void TileLayer::setCell(int x, int y, const Cell &cell)
+void TileLayer::updateMargins(const Cell &cell)
 {
-    Q_ASSERT(contains(x, y));
+    const Tile *tile = cell.tile();
+    QSize size = tile->size();
 
-    if (cell.tile) {
-        QSize size = cell.tile->size();
+    if (cell.flippedAntiDiagonally())
+        size.transpose();
 
-        if (cell.flippedAntiDiagonally)
-            size.transpose();
+    const QPoint offset = tile->tileset()->tileOffset();
 
-        const QPoint offset = cell.tile->tileset()->tileOffset();
+    mMaxTileSize = maxSize(size, mMaxTileSize);
+    mOffsetMargins = maxMargins(QMargins(-offset.x(),
+                                         -offset.y(),
+                                         offset.x(),
+                                         offset.y()),
+                                mOffsetMargins);
+}
 
-        mMaxTileSize = maxSize(size, mMaxTileSize);
-        mOffsetMargins = maxMargins(QMargins(-offset.x(),
-                                             -offset.y(),
-                                             offset.x(),
-                                             offset.y()),
-                                    mOffsetMargins);
+void TileLayer::setCell(int x, int y, const Cell &cell)
+{
+    Q_ASSERT(contains(x, y));
+
+    if (!cell.isEmpty()) {
+        updateMargins(cell);
 
         if (mMap)
             mMap->adjustDrawMargins(drawMargins());
+    } else if (mStorage == ChunkedStorage) {
+        // Don't allocate a chunk just to store an empty cell
+        if (cellAt(x, y).isEmpty())
+            return;
+    }
+
+    cellRef(x, y) = cell;
+}
+
+void TileLayer::setCellRange(int index, int count, const Cell *cells)
+{
+    Q_ASSERT(index >= 0 && count >= 0);
+    Q_ASSERT(index + count <= mWidth * mHeight);
+
+    // Neighbouring cells often refer to the same tile, in which case they
+    // don't affect the margins
+    Cell lastCell;
+    bool nonEmpty = false;
+
+    for (int i = 0; i < count; ++i) {
+        const Cell &cell = cells[i];
+        if (cell.isEmpty() || cell == lastCell)
+            continue;
+
+        updateMargins(cell);
+        lastCell = cell;
+        nonEmpty = true;
     }
 
-    mGrid[x + y * mWidth] = cell;
+    if (nonEmpty && mMap)
+        mMap->adjustDrawMargins(drawMargins());
+
+    if (mStorage == DenseStorage) {
+        std::copy(cells, cells + count, mGrid.begin() + index);
+        return;
+    }
+
+    int x = index % mWidth;
+    int y = index / mWidth;
+
+    for (int i = 0; i < count; ++i) {
+        const Cell &cell = cells[i];
+
+        // Don't allocate chunks just to store empty cells
+        if (!cell.isEmpty() || !cellAt(x, y).isEmpty())
+            cellRef(x, y) = cell;
+
+        if (++x == mWidth) {
+            x = 0;
+            ++y;
+        }
+    }
 }
 
 TileLayer *TileLayer::copy(const QRegion &region) const
@@ -137,12 +313,18 @@ void TileLayer::merge(const QPoint &pos, const TileLayer *layer)
     QRect area = QRect(pos, QSize(layer->width(), layer->height()));
     area &= QRect(0, 0, width(), height());
 
-    for (int y = area.top(); y <= area.bottom(); ++y) {
-        for (int x = area.left(); x <= area.right(); ++x) {
-            const Cell &cell = layer->cellAt(x - area.left(),
-                                             y - area.top());
-            if (!cell.isEmpty())
-                setCell(x, y, cell);
+    // Only the parts of the other layer that store cells are relevant
+    foreach (QRect rect, layer->storedRects()) {
+        rect.translate(pos);
+        rect &= area;
+
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            for (int x = rect.left(); x <= rect.right(); ++x) {
+                const Cell &cell = layer->cellAt(x - pos.x(),
+                                                 y - pos.y());
+                if (!cell.isEmpty())
+                    setCell(x, y, cell);
+            }
         }
     }
 }
@@ -174,26 +356,32 @@ void TileLayer::erase(const QRegion &area)
 
 void TileLayer::flip(FlipDirection direction)
 {
-    QVector<Cell> newGrid(mWidth * mHeight);
+    TileLayer newLayer(QString(), 0, 0, 0, 0);
+    newLayer.resetStorage(mWidth, mHeight, mStorage);
 
     Q_ASSERT(direction == FlipHorizontally || direction == FlipVertically);
 
-    for (int y = 0; y < mHeight; ++y) {
-        for (int x = 0; x < mWidth; ++x) {
-            Cell &dest = newGrid[x + y * mWidth];
-            if (direction == FlipHorizontally) {
-                const Cell &source = cellAt(mWidth - x - 1, y);
-                dest = source;
-                dest.flippedHorizontally = !source.flippedHorizontally;
-            } else if (direction == FlipVertically) {
-                const Cell &source = cellAt(x, mHeight - y - 1);
-                dest = source;
-                dest.flippedVertically = !source.flippedVertically;
+    foreach (const QRect &rect, storedRects()) {
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            for (int x = rect.left(); x <= rect.right(); ++x) {
+                const Cell &source = cellAt(x, y);
+                if (source.isEmpty())
+                    continue;
+
+                if (direction == FlipHorizontally) {
+                    Cell &dest = newLayer.cellRef(mWidth - x - 1, y);
+                    dest = source;
+                    dest.toggleFlipFlags(Cell::FlippedHorizontally);
+                } else if (direction == FlipVertically) {
+                    Cell &dest = newLayer.cellRef(x, mHeight - y - 1);
+                    dest = source;
+                    dest.toggleFlipFlags(Cell::FlippedVertically);
+                }
             }
         }
     }
 
-    mGrid = newGrid;
+    takeStorage(newLayer);
 }
 
 void TileLayer::rotate(RotateDirection direction)
@@ -206,28 +394,25 @@ void TileLayer::rotate(RotateDirection direction)
 
     int newWidth = mHeight;
     int newHeight = mWidth;
-    QVector<Cell> newGrid(newWidth * newHeight);
 
-    for (int y = 0; y < mHeight; ++y) {
-        for (int x = 0; x < mWidth; ++x) {
-            const Cell &source = cellAt(x, y);
-            Cell dest = source;
+    TileLayer newLayer(QString(), 0, 0, 0, 0);
+    newLayer.resetStorage(newWidth, newHeight, mStorage);
 
-            unsigned char mask =
-                    (dest.flippedHorizontally << 2) |
-                    (dest.flippedVertically << 1) |
-                    (dest.flippedAntiDiagonally << 0);
+    foreach (const QRect &rect, storedRects()) {
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            for (int x = rect.left(); x <= rect.right(); ++x) {
+                const Cell &source = cellAt(x, y);
+                if (source.isEmpty())
+                    continue;
 
-            mask = rotateMask[mask];
+                Cell dest = source;
+                dest.setFlipFlags(rotateMask[source.flipFlags()]);
 
-            dest.flippedHorizontally = (mask & 4) != 0;
-            dest.flippedVertically = (mask & 2) != 0;
-            dest.flippedAntiDiagonally = (mask & 1) != 0;
-
-            if (direction == RotateRight)
-                newGrid[x * newWidth + (mHeight - y - 1)] = dest;
-            else
-                newGrid[(mWidth - x - 1) * newWidth + y] = dest;
+                if (direction == RotateRight)
+                    newLayer.cellRef(mHeight - y - 1, x) = dest;
+                else
+                    newLayer.cellRef(y, mWidth - x - 1) = dest;
+            }
         }
     }
 
@@ -236,7 +421,7 @@ void TileLayer::rotate(RotateDirection direction)
 
     mWidth = newWidth;
     mHeight = newHeight;
-    mGrid = newGrid;
+    takeStorage(newLayer);
 }
 
 
@@ -244,19 +429,25 @@ QSet<Tileset*> TileLayer::usedTilesets() const
 {
     QSet<Tileset*> tilesets;
 
-    for (int i = 0, i_end = mGrid.size(); i < i_end; ++i)
-        if (const Tile *tile = mGrid.at(i).tile)
-            tilesets.insert(tile->tileset());
+    foreach (const QRect &rect, storedRects())
+        for (int y = rect.top(); y <= rect.bottom(); ++y)
+            for (int x = rect.left(); x <= rect.right(); ++x)
+                if (const Tile *tile = cellAt(x, y).tile())
+                    tilesets.insert(tile->tileset());
 
     return tilesets;
 }
 
 bool TileLayer::referencesTileset(const Tileset *tileset) const
 {
-    for (int i = 0, i_end = mGrid.size(); i < i_end; ++i) {
-        const Tile *tile = mGrid.at(i).tile;
-        if (tile && tile->tileset() == tileset)
-            return true;
+    foreach (const QRect &rect, storedRects()) {
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            for (int x = rect.left(); x <= rect.right(); ++x) {
+                const Tile *tile = cellAt(x, y).tile();
+                if (tile && tile->tileset() == tileset)
+                    return true;
+            }
+        }
     }
     return false;
 }
@@ -265,31 +456,40 @@ QRegion TileLayer::tilesetReferences(Tileset *tileset) const
 {
     QRegion region;
 
-    for (int y = 0; y < mHeight; ++y)
-        for (int x = 0; x < mWidth; ++x)
-            if (const Tile *tile = cellAt(x, y).tile)
-                if (tile->tileset() == tileset)
-                    region += QRegion(x + mX, y + mY, 1, 1);
+    foreach (const QRect &rect, storedRects())
+        for (int y = rect.top(); y <= rect.bottom(); ++y)
+            for (int x = rect.left(); x <= rect.right(); ++x)
+                if (const Tile *tile = cellAt(x, y).tile())
+                    if (tile->tileset() == tileset)
+                        region += QRegion(x + mX, y + mY, 1, 1);
 
     return region;
 }
 
 void TileLayer::removeReferencesToTileset(Tileset *tileset)
 {
-    for (int i = 0, i_end = mGrid.size(); i < i_end; ++i) {
-        const Tile *tile = mGrid.at(i).tile;
-        if (tile && tile->tileset() == tileset)
-            mGrid.replace(i, Cell());
+    foreach (const QRect &rect, storedRects()) {
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            for (int x = rect.left(); x <= rect.right(); ++x) {
+                const Tile *tile = cellAt(x, y).tile();
+                if (tile && tile->tileset() == tileset)
+                    cellRef(x, y) = Cell();
+            }
+        }
     }
 }
 
 void TileLayer::replaceReferencesToTileset(Tileset *oldTileset,
                                            Tileset *newTileset)
 {
-    for (int i = 0, i_end = mGrid.size(); i < i_end; ++i) {
-        const Tile *tile = mGrid.at(i).tile;
-        if (tile && tile->tileset() == oldTileset)
-            mGrid[i].tile = newTileset->tileAt(tile->id());
+    foreach (const QRect &rect, storedRects()) {
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            for (int x = rect.left(); x <= rect.right(); ++x) {
+                const Tile *tile = cellAt(x, y).tile();
+                if (tile && tile->tileset() == oldTileset)
+                    cellRef(x, y).setTile(newTileset->tileAt(tile->id()));
+            }
+        }
     }
 }
 
@@ -298,22 +498,25 @@ void TileLayer::resize(const QSize &size, const QPoint &offset)
     if (this->size() == size && offset.isNull())
         return;
 
-    QVector<Cell> newGrid(size.width() * size.height());
+    TileLayer newLayer(QString(), 0, 0, 0, 0);
+    newLayer.resetStorage(size.width(), size.height(), mStorage);
 
     // Copy over the preserved part
-    const int startX = qMax(0, -offset.x());
-    const int startY = qMax(0, -offset.y());
-    const int endX = qMin(mWidth, size.width() - offset.x());
-    const int endY = qMin(mHeight, size.height() - offset.y());
-
-    for (int y = startY; y < endY; ++y) {
-        for (int x = startX; x < endX; ++x) {
-            const int index = x + offset.x() + (y + offset.y()) * size.width();
-            newGrid[index] = cellAt(x, y);
+    const QRect preserved = QRect(-offset, size) & QRect(0, 0, mWidth, mHeight);
+
+    foreach (QRect rect, storedRects()) {
+        rect &= preserved;
+
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            for (int x = rect.left(); x <= rect.right(); ++x) {
+                const Cell &cell = cellAt(x, y);
+                if (!cell.isEmpty())
+                    newLayer.cellRef(x + offset.x(), y + offset.y()) = cell;
+            }
         }
     }
 
-    mGrid = newGrid;
+    takeStorage(newLayer);
     Layer::resize(size, offset);
 }
 
@@ -321,45 +524,50 @@ void TileLayer::offset(const QPoint &offset,
                        const QRect &bounds,
                        bool wrapX, bool wrapY)
 {
-    QVector<Cell> newGrid(mWidth * mHeight);
+    TileLayer newLayer(QString(), 0, 0, 0, 0);
+    newLayer.resetStorage(mWidth, mHeight, mStorage);
+
+    foreach (const QRect &rect, storedRects()) {
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            for (int x = rect.left(); x <= rect.right(); ++x) {
+                const Cell &cell = cellAt(x, y);
+                if (cell.isEmpty())
+                    continue;
+
+                // Keep out of bounds tiles where they are
+                if (!bounds.contains(x, y)) {
+                    newLayer.cellRef(x, y) = cell;
+                    continue;
+                }
 
-    for (int y = 0; y < mHeight; ++y) {
-        for (int x = 0; x < mWidth; ++x) {
-            // Skip out of bounds tiles
-            if (!bounds.contains(x, y)) {
-                newGrid[x + y * mWidth] = cellAt(x, y);
-                continue;
-            }
+                // Get position to push tile value to
+                int newX = x + offset.x();
+                int newY = y + offset.y();
 
-            // Get position to pull tile value from
-            int oldX = x - offset.x();
-            int oldY = y - offset.y();
+                // Wrap x value that will be pushed to
+                if (wrapX && bounds.width() > 0) {
+                    while (newX < bounds.left())
+                        newX += bounds.width();
+                    while (newX > bounds.right())
+                        newX -= bounds.width();
+                }
 
-            // Wrap x value that will be pulled from
-            if (wrapX && bounds.width() > 0) {
-                while (oldX < bounds.left())
-                    oldX += bounds.width();
-                while (oldX > bounds.right())
-                    oldX -= bounds.width();
-            }
+                // Wrap y value that will be pushed to
+                if (wrapY && bounds.height() > 0) {
+                    while (newY < bounds.top())
+                        newY += bounds.height();
+                    while (newY > bounds.bottom())
+                        newY -= bounds.height();
+                }
 
-            // Wrap y value that will be pulled from
-            if (wrapY && bounds.height() > 0) {
-                while (oldY < bounds.top())
-                    oldY += bounds.height();
-                while (oldY > bounds.bottom())
-                    oldY -= bounds.height();
+                // Set the new tile
+                if (contains(newX, newY) && bounds.contains(newX, newY))
+                    newLayer.cellRef(newX, newY) = cell;
             }
-
-            // Set the new tile
-            if (contains(oldX, oldY) && bounds.contains(oldX, oldY))
-                newGrid[x + y * mWidth] = cellAt(oldX, oldY);
-            else
-                newGrid[x + y * mWidth] = Cell();
         }
     }
 
-    mGrid = newGrid;
+    takeStorage(newLayer);
 }
 
 bool TileLayer::canMergeWith(Layer *other) const
@@ -390,16 +598,29 @@ QRegion TileLayer::computeDiffRegion(const TileLayer *other) const
     QRect r = QRect(0, 0, width(), height());
     r &= QRect(dx, dy, other->width(), other->height());
 
-    for (int y = r.top(); y <= r.bottom(); ++y) {
-        for (int x = r.left(); x <= r.right(); ++x) {
-            if (cellAt(x, y) != other->cellAt(x - dx, y - dy)) {
-                const int rangeStart = x;
-                while (x <= r.right() &&
-                       cellAt(x, y) != other->cellAt(x - dx, y - dy)) {
-                    ++x;
+    // Only areas where either layer stores cells can differ
+    const QVector<QRect> ownRects = storedRects();
+    const QVector<QRect> otherRects = other->storedRects();
+    QRegion ownStored;
+    ownStored.setRects(ownRects.constData(), ownRects.size());
+    QRegion otherStored;
+    otherStored.setRects(otherRects.constData(), otherRects.size());
+    otherStored.translate(dx, dy);
+
+    const QRegion candidates = (ownStored | otherStored) & r;
+
+    foreach (const QRect &rect, candidates.rects()) {
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            for (int x = rect.left(); x <= rect.right(); ++x) {
+                if (cellAt(x, y) != other->cellAt(x - dx, y - dy)) {
+                    const int rangeStart = x;
+                    while (x <= rect.right() &&
+                           cellAt(x, y) != other->cellAt(x - dx, y - dy)) {
+                        ++x;
+                    }
+                    const int rangeEnd = x;
+                    ret += QRect(rangeStart, y, rangeEnd - rangeStart, 1);
                 }
-                const int rangeEnd = x;
-                ret += QRect(rangeStart, y, rangeEnd - rangeStart, 1);
             }
         }
     }
@@ -409,9 +630,11 @@ QRegion TileLayer::computeDiffRegion(const TileLayer *other) const
 
 bool TileLayer::isEmpty() const
 {
-    for (int i = 0, i_end = mGrid.size(); i < i_end; ++i)
-        if (!mGrid.at(i).isEmpty())
-            return false;
+    foreach (const QRect &rect, storedRects())
+        for (int y = rect.top(); y <= rect.bottom(); ++y)
+            for (int x = rect.left(); x <= rect.right(); ++x)
+                if (!cellAt(x, y).isEmpty())
+                    return false;
 
     return true;
 }
@@ -429,7 +652,10 @@ Layer *TileLayer::clone() const
 TileLayer *TileLayer::initializeClone(TileLayer *clone) const
 {
     Layer::initializeClone(clone);
+    clone->mStorage = mStorage;
     clone->mGrid = mGrid;
+    clone->mChunks = mChunks;
+    clone->mChunkColumns = mChunkColumns;
     clone->mMaxTileSize = mMaxTileSize;
     clone->mOffsetMargins = mOffsetMargins;
     return clone;
@@ -46,46 +46,99 @@ class Tileset;
 
 /**
  * A cell on a tile layer grid.
+ *
+ * The tile pointer and the flip flags are packed into a single word. This
+ * relies on tiles being allocated at addresses aligned to at least 8 bytes,
+ * which leaves the lowest 3 bits of the pointer free for the flags.
  */
 class Cell
 {
 public:
+    /**
+     * The flip flags, in the bit order used by the rotation masks of
+     * TileLayer::rotate().
+     */
+    enum FlipFlag {
+        FlippedAntiDiagonally   = 0x1,
+        FlippedVertically       = 0x2,
+        FlippedHorizontally     = 0x4,
+        FlipMask                = 0x7
+    };
+
     Cell() :
-        tile(0),
-        flippedHorizontally(false),
-        flippedVertically(false),
-        flippedAntiDiagonally(false)
+        mData(0)
     {}
 
     explicit Cell(Tile *tile) :
-        tile(tile),
-        flippedHorizontally(false),
-        flippedVertically(false),
-        flippedAntiDiagonally(false)
-    {}
+        mData(reinterpret_cast<quintptr>(tile))
+    {
+        Q_ASSERT((mData & FlipMask) == 0);
+    }
 
-    bool isEmpty() const { return tile == 0; }
+    bool isEmpty() const { return tile() == 0; }
 
-    bool operator == (const Cell &other) const
+    Tile *tile() const
+    { return reinterpret_cast<Tile*>(mData & ~quintptr(FlipMask)); }
+
+    void setTile(Tile *tile)
     {
-        return tile == other.tile
-                && flippedHorizontally == other.flippedHorizontally
-                && flippedVertically == other.flippedVertically
-                && flippedAntiDiagonally == other.flippedAntiDiagonally;
+        const quintptr data = reinterpret_cast<quintptr>(tile);
+        Q_ASSERT((data & FlipMask) == 0);
+        mData = data | flipFlags();
     }
 
+    bool flippedHorizontally() const
+    { return mData & FlippedHorizontally; }
+
+    bool flippedVertically() const
+    { return mData & FlippedVertically; }
+
+    bool flippedAntiDiagonally() const
+    { return mData & FlippedAntiDiagonally; }
+
+    void setFlippedHorizontally(bool flipped)
+    { setFlipFlag(FlippedHorizontally, flipped); }
+
+    void setFlippedVertically(bool flipped)
+    { setFlipFlag(FlippedVertically, flipped); }
+
+    void setFlippedAntiDiagonally(bool flipped)
+    { setFlipFlag(FlippedAntiDiagonally, flipped); }
+
+    /**
+     * Returns the combination of FlipFlag values set on this cell.
+     */
+    unsigned flipFlags() const { return unsigned(mData & FlipMask); }
+
+    /**
+     * Replaces the flip flags of this cell with the given combination of
+     * FlipFlag values.
+     */
+    void setFlipFlags(unsigned flags)
+    { mData = (mData & ~quintptr(FlipMask)) | (flags & FlipMask); }
+
+    /**
+     * Toggles the given combination of FlipFlag values.
+     */
+    void toggleFlipFlags(unsigned flags)
+    { mData ^= (flags & FlipMask); }
+
+    bool operator == (const Cell &other) const
+    { return mData == other.mData; }
+
     bool operator != (const Cell &other) const
+    { return mData != other.mData; }
+
+private:
+    void setFlipFlag(FlipFlag flag, bool enabled)
     {
-        return tile != other.tile
-                || flippedHorizontally != other.flippedHorizontally
-                || flippedVertically != other.flippedVertically
-                || flippedAntiDiagonally != other.flippedAntiDiagonally;
+        if (enabled)
+            mData |= flag;
+        else
+            mData &= ~quintptr(flag);
     }
 
-    Tile *tile;
-    bool flippedHorizontally;
-    bool flippedVertically;
-    bool flippedAntiDiagonally;
+    quintptr mData;
 };
 
 /**
@@ -99,10 +152,42 @@ class TILEDSHARED_EXPORT TileLayer : public Layer
 {
 public:
     /**
-     * Constructor.
+     * The ways in which the cells of a tile layer can be stored.
+     *
+     * With DenseStorage, a cell is allocated for every position of the
+     * layer. With ChunkedStorage, the layer is divided into chunks of
+     * ChunkSize x ChunkSize cells which are only allocated once a non-empty
+     * cell is placed in them. The latter keeps memory usage of large, mostly
+     * empty layers proportional to the painted area.
+     */
+    enum Storage {
+        DenseStorage,
+        ChunkedStorage
+    };
+
+    enum {
+        ChunkBits = 5,
+        ChunkSize = 1 << ChunkBits,
+        ChunkMask = ChunkSize - 1
+    };
+
+    /**
+     * Constructor. Layers larger than 1024x1024 tiles automatically use
+     * chunked storage.
      */
     TileLayer(const QString &name, int x, int y, int width, int height);
 
+    /**
+     * Returns the way in which the cells of this layer are stored.
+     */
+    Storage storage() const { return mStorage; }
+
+    /**
+     * Changes the way in which the cells of this layer are stored. The
+     * contents of the layer are preserved.
+     */
+    void setStorage(Storage storage);
+
     /**
      * Returns the maximum tile size of this layer.
      */
@@ -142,7 +227,11 @@ public:
      * coordinates have to be within this layer.
      */
     const Cell &cellAt(int x, int y) const
-    { return mGrid.at(x + y * mWidth); }
+    {
+        if (mStorage == DenseStorage)
+            return mGrid.at(x + y * mWidth);
+        return chunkedCellAt(x, y);
+    }
 
     const Cell &cellAt(const QPoint &point) const
     { return cellAt(point.x(), point.y()); }
@@ -152,6 +241,13 @@ public:
      */
     void setCell(int x, int y, const Cell &cell);
 
+    /**
+     * Sets \a count cells, starting at the given row-major cell \a index, to
+     * the given \a cells. This is equivalent to calling setCell() for each
+     * cell, but the maximum tile size and draw margins are only updated once.
+     */
+    void setCellRange(int index, int count, const Cell *cells);
+
     /**
      * Returns a copy of the area specified by the given \a region. The
      * caller is responsible for the returned tile layer.
@@ -262,9 +358,45 @@ protected:
     TileLayer *initializeClone(TileLayer *clone) const;
 
 private:
+    const Cell &chunkedCellAt(int x, int y) const;
+
+    /**
+     * Takes into account the given cell for the maximum tile size and the
+     * offset margins. Does not notify the map.
+     */
+    void updateMargins(const Cell &cell);
+
+    /**
+     * Returns a writable reference to the cell at the given coordinates,
+     * allocating its chunk when necessary. Does not update the draw margins.
+     */
+    Cell &cellRef(int x, int y);
+
+    /**
+     * Returns the rectangles in which non-empty cells may be found. For
+     * dense storage this is the whole layer, for chunked storage these are
+     * the allocated chunks, in top-to-bottom, left-to-right order.
+     */
+    QVector<QRect> storedRects() const;
+
+    /**
+     * Turns this layer into an empty layer of \a width by \a height cells,
+     * using the given \a storage. Used to set up scratch layers when
+     * rearranging cells.
+     */
+    void resetStorage(int width, int height, Storage storage);
+
+    /**
+     * Takes over the cell storage of \a other.
+     */
+    void takeStorage(TileLayer &other);
+
     QSize mMaxTileSize;
     QMargins mOffsetMargins;
+    Storage mStorage;
     QVector<Cell> mGrid;
+    QVector<QVector<Cell> > mChunks;
+    int mChunkColumns;
 };
 
 } // namespace Tiled
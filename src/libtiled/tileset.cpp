@@ -32,6 +32,9 @@
 #include "terrain.h"
 
 #include <QBitmap>
+#include <QtAlgorithms>
+
+#include <climits>
 
 using namespace Tiled;
 
@@ -58,32 +61,47 @@ bool Tileset::loadFromImage(const QImage &image, const QString &fileName)
     int oldTilesetSize = mTiles.size();
     int tileNum = 0;
 
+    // The tiles all refer to their part of a single pixmap, so that the
+    // image is converted and masked only once
+    QPixmap atlas = QPixmap::fromImage(image);
+
+    if (mTransparentColor.isValid()) {
+        const QImage mask =
+                image.createMaskFromColor(mTransparentColor.rgb());
+        atlas.setMask(QBitmap::fromImage(mask));
+    }
+
+    const QImage argbImage = image.convertToFormat(QImage::Format_ARGB32);
+
     for (int y = mMargin; y <= stopHeight; y += mTileHeight + mTileSpacing) {
         for (int x = mMargin; x <= stopWidth; x += mTileWidth + mTileSpacing) {
-            const QImage tileImage = image.copy(x, y, mTileWidth, mTileHeight);
-            QPixmap tilePixmap = QPixmap::fromImage(tileImage);
-
-            if (mTransparentColor.isValid()) {
-                const QImage mask =
-                        tileImage.createMaskFromColor(mTransparentColor.rgb());
-                tilePixmap.setMask(QBitmap::fromImage(mask));
-            }
+            const QRect rect(x, y, mTileWidth, mTileHeight);
 
+            Tile *tile;
             if (tileNum < oldTilesetSize) {
-                mTiles.at(tileNum)->setImage(tilePixmap);
+                tile = mTiles.at(tileNum);
+                tile->setImage(atlas, rect);
             } else {
-                mTiles.append(new Tile(tilePixmap, tileNum, this));
+                tile = new Tile(atlas, rect, tileNum, this);
+                mTiles.append(tile);
+                mTerrainIndexDirty = true;
             }
+            tile->setAverageColor(Tile::computeAverageColor(argbImage, rect,
+                                                            mTransparentColor));
             ++tileNum;
         }
     }
 
     // Blank out any remaining tiles to avoid confusion
-    while (tileNum < oldTilesetSize) {
-        QPixmap tilePixmap = QPixmap(mTileWidth, mTileHeight);
-        tilePixmap.fill();
-        mTiles.at(tileNum)->setImage(tilePixmap);
-        ++tileNum;
+    if (tileNum < oldTilesetSize) {
+        QPixmap blank = QPixmap(mTileWidth, mTileHeight);
+        blank.fill();
+
+        while (tileNum < oldTilesetSize) {
+            mTiles.at(tileNum)->setImage(blank);
+            mTiles.at(tileNum)->setAverageColor(qRgb(255, 255, 255));
+            ++tileNum;
+        }
     }
 
     mImageWidth = image.width();
@@ -140,7 +158,7 @@ void Tileset::insertTerrain(int index, Terrain *terrain)
         }
     }
 
-    mTerrainDistancesDirty = true;
+    markTerrainDistancesDirty();
 }
 
 Terrain *Tileset::takeTerrainAt(int index)
@@ -162,7 +180,7 @@ Terrain *Tileset::takeTerrainAt(int index)
         }
     }
 
-    mTerrainDistancesDirty = true;
+    markTerrainDistancesDirty();
 
     return terrain;
 }
@@ -174,99 +192,148 @@ int Tileset::terrainTransitionPenalty(int terrainType0, int terrainType1)
         mTerrainDistancesDirty = false;
     }
 
-    terrainType0 = terrainType0 == 255 ? -1 : terrainType0;
-    terrainType1 = terrainType1 == 255 ? -1 : terrainType1;
+    // No terrain (255 or -1) is stored at index 0
+    const int from = terrainType0 == 255 ? 0 : terrainType0 + 1;
+    const int to = terrainType1 == 255 ? 0 : terrainType1 + 1;
+
+    return mTerrainDistances.at(from * (terrainCount() + 1) + to);
+}
+
+static bool tileIdLessThan(const Tile *a, const Tile *b)
+{
+    return a->id() < b->id();
+}
+
+QList<Tile*> Tileset::bestTerrainMatches(unsigned terrain,
+                                         unsigned considerationMask)
+{
+    if (mTerrainIndexDirty) {
+        rebuildTerrainIndex();
+        mTerrainIndexDirty = false;
+    }
+
+    const quint64 key = (quint64(terrain) << 32) | considerationMask;
+    QHash<quint64, QList<Tile*> >::const_iterator cached =
+            mTerrainMatches.constFind(key);
+    if (cached != mTerrainMatches.constEnd())
+        return cached.value();
+
+    QList<Tile*> matches;
+    int penalty = INT_MAX;
+
+    // All tiles sharing a terrain have the same penalty, so it only needs
+    // to be calculated once for each distinct terrain
+    QHash<unsigned, QList<Tile*> >::const_iterator it =
+            mTilesByTerrain.constBegin();
+    QHash<unsigned, QList<Tile*> >::const_iterator it_end =
+            mTilesByTerrain.constEnd();
+
+    for (; it != it_end; ++it) {
+        const unsigned tileTerrain = it.key();
+        if ((tileTerrain & considerationMask) != (terrain & considerationMask))
+            continue;
+
+        int transitionPenalty = 0;
+        bool reachable = true;
+
+        for (int shift = 0; shift < 32; shift += 8) {
+            const int p = terrainTransitionPenalty((tileTerrain >> shift) & 0xFF,
+                                                   (terrain >> shift) & 0xFF);
+            if (p < 0) {
+                reachable = false;
+                break;
+            }
+            transitionPenalty += p;
+        }
+
+        if (!reachable || transitionPenalty > penalty)
+            continue;
+
+        if (transitionPenalty < penalty) {
+            matches.clear();
+            penalty = transitionPenalty;
+        }
+        matches.append(it.value());
+    }
+
+    // Keep the tileset order, which the terrain probabilities rely on to
+    // pick the same tiles as before
+    qSort(matches.begin(), matches.end(), tileIdLessThan);
 
-    // Do some magic, since we don't have a transition array for no-terrain
-    if (terrainType0 == -1 && terrainType1 == -1)
-        return 0;
-    if (terrainType0 == -1)
-        return mTerrainTypes.at(terrainType1)->transitionDistance(terrainType0);
-    return mTerrainTypes.at(terrainType0)->transitionDistance(terrainType1);
+    mTerrainMatches.insert(key, matches);
+    return matches;
+}
+
+void Tileset::rebuildTerrainIndex()
+{
+    mTilesByTerrain.clear();
+    mTerrainMatches.clear();
+
+    foreach (Tile *tile, mTiles)
+        mTilesByTerrain[tile->terrain()].append(tile);
 }
 
 void Tileset::recalculateTerrainDistances()
 {
-    // some fancy macros which can search for a value in each byte of a word simultaneously
-    #define hasZeroByte(dword) (((dword) - 0x01010101UL) & ~(dword) & 0x80808080UL)
-    #define hasByteEqualTo(dword, value) (hasZeroByte((dword) ^ (~0UL/255 * (value))))
+    // Terrain distances are the number of transitions required before one
+    // terrain may meet another. Terrains that have no transition path have a
+    // distance of -1. The matrix includes "no terrain" at index 0.
+    const int n = terrainCount() + 1;
+    mTerrainDistances.fill(-1, n * n);
+    int *distance = mTerrainDistances.data();
 
-    // Terrain distances are the number of transitions required before one terrain may meet another
-    // Terrains that have no transition path have a distance of -1
+    // No terrain can always meet itself
+    distance[0] = 0;
 
-    for (int i = 0; i < terrainCount(); ++i) {
-        Terrain *type = terrain(i);
-        QVector<int> distance(terrainCount() + 1, -1);
+    // Collect the direct transitions in a single pass over the tiles. Each
+    // corner neighbours the two adjacent corners, but not the one that is
+    // diagonally opposite.
+    static const int neighbours[4][2] = { { 1, 2 }, { 0, 3 }, { 0, 3 }, { 1, 2 } };
 
-        // Check all tiles for transitions to other terrain types
-        for (int j = 0; j < tileCount(); ++j) {
-            Tile *t = tileAt(j);
+    foreach (const Tile *tile, mTiles) {
+        if (tile->terrain() == 0xFFFFFFFF)
+            continue;
 
-            if (!hasByteEqualTo(t->terrain(), i))
-                continue;
+        int corners[4];
+        for (int corner = 0; corner < 4; ++corner)
+            corners[corner] = tile->cornerTerrainId(corner) + 1;
 
-            // This tile has transitions, add the transitions as neightbours (distance 1)
-            int tl = t->cornerTerrainId(0);
-            int tr = t->cornerTerrainId(1);
-            int bl = t->cornerTerrainId(2);
-            int br = t->cornerTerrainId(3);
+        for (int corner = 0; corner < 4; ++corner) {
+            const int a = corners[corner];
 
-            // Terrain on diagonally opposite corners are not actually a neighbour
-            if (tl == i || br == i) {
-                distance[tr + 1] = 1;
-                distance[bl + 1] = 1;
-            }
-            if (tr == i || bl == i) {
-                distance[tl + 1] = 1;
-                distance[br + 1] = 1;
-            }
+            // This terrain has at least one tile of its own type
+            distance[a * n + a] = 0;
 
-            // terrain has at least one tile of its own type
-            distance[i + 1] = 0;
+            for (int k = 0; k < 2; ++k) {
+                const int b = corners[neighbours[corner][k]];
+                if (a != b)
+                    distance[a * n + b] = 1;
+            }
         }
-
-        type->setTransitionDistances(distance);
     }
 
-    // Calculate indirect transition distances
-    bool bNewConnections;
-    do {
-        bNewConnections = false;
+    // Calculate the indirect transition distances (Floyd-Warshall). The
+    // direct transitions are symmetric, so the result is as well.
+    for (int k = 0; k < n; ++k) {
+        const int *rowK = distance + k * n;
 
-        // For each combination of terrain types
-        for (int i = 0; i < terrainCount(); ++i) {
-            Terrain *t0 = terrain(i);
-            for (int j = 0; j < terrainCount(); ++j) {
-                if (i == j)
+        for (int i = 0; i < n; ++i) {
+            int *rowI = distance + i * n;
+            const int dik = rowI[k];
+            if (dik == -1)
+                continue;
+
+            for (int j = 0; j < n; ++j) {
+                const int dkj = rowK[j];
+                if (dkj == -1 || i == j)
                     continue;
-                Terrain *t1 = terrain(j);
-
-                // Scan through each terrain type, and see if we have any in common
-                for (int t = -1; t < terrainCount(); ++t) {
-                    int d0 = t0->transitionDistance(t);
-                    int d1 = t1->transitionDistance(t);
-                    if (d0 == -1 || d1 == -1)
-                        continue;
-
-                    // We have cound a common connection
-                    int d = t0->transitionDistance(j);
-                    Q_ASSERT(t1->transitionDistance(i) == d);
-
-                    // If the new path is shorter, record the new distance
-                    if (d == -1 || d0 + d1 < d) {
-                        d = d0 + d1;
-                        t0->setTransitionDistance(j, d);
-                        t1->setTransitionDistance(i, d);
-
-                        // We're making progress, flag for another iteration...
-                        bNewConnections = true;
-                    }
-                }
+
+                const int d = dik + dkj;
+                if (rowI[j] == -1 || d < rowI[j])
+                    rowI[j] = d;
             }
         }
-
-        // Repeat while we are still making new connections (could take a number of iterations for distant terrain types to connect)
-    } while (bNewConnections);
+    }
 }
 
 void Tileset::addTile(const QPixmap &image)
@@ -274,6 +341,7 @@ void Tileset::addTile(const QPixmap &image)
     detachExternalImage();
     Tile *newTile = new Tile(image, tileCount(), this);
     mTiles.append(newTile);
+    mTerrainIndexDirty = true;
     if (mTileHeight < image.height())
         mTileHeight = image.height();
     if (mTileWidth < image.width())
@@ -285,13 +353,12 @@ void Tileset::setTileImage(int index, const QPixmap &image)
     detachExternalImage();
     Tile *tile = tileAt(index);
     if (tile) {
-        QPixmap previousImage = tile->image();
+        const QSize previousSize = tile->size();
         tile->setImage(image);
-        if (previousImage.height() != image.height() ||
-                previousImage.width() != image.width()) {
+        if (previousSize != image.size()) {
             // Update our max. tile size
-            if (previousImage.height() == mTileHeight ||
-                    previousImage.width() == mTileWidth) {
+            if (previousSize.height() == mTileHeight ||
+                    previousSize.width() == mTileWidth) {
                 // This used to be the max image; we have to recompute
                 updateTileSize();
             } else {
@@ -305,6 +372,13 @@ void Tileset::setTileImage(int index, const QPixmap &image)
     }
 }
 
+void Tileset::setTileImage(int index, const QImage &image)
+{
+    setTileImage(index, QPixmap::fromImage(image));
+    if (Tile *tile = tileAt(index))
+        tile->setAverageColor(Tile::computeAverageColor(image, image.rect()));
+}
+
 void Tileset::detachExternalImage()
 {
     mFileName = QString();
@@ -33,6 +33,7 @@
 #include "object.h"
 
 #include <QColor>
+#include <QHash>
 #include <QList>
 #include <QVector>
 #include <QPoint>
@@ -74,7 +75,8 @@ public:
         mImageWidth(0),
         mImageHeight(0),
         mColumnCount(0),
-        mTerrainDistancesDirty(false)
+        mTerrainDistancesDirty(true),
+        mTerrainIndexDirty(false)
     {
         Q_ASSERT(tileSpacing >= 0);
         Q_ASSERT(margin >= 0);
@@ -273,6 +275,18 @@ public:
      */
     int terrainTransitionPenalty(int terrainType0, int terrainType1);
 
+    /**
+     * Returns the tiles that match \a terrain on the corners selected by
+     * \a considerationMask and that have the lowest total transition penalty
+     * towards \a terrain. Tiles from which the target terrain can't be
+     * reached are never returned. The tiles are returned in tileset order.
+     *
+     * The result is looked up in an index that is built on demand and
+     * discarded whenever the terrain information of this tileset changes.
+     */
+    QList<Tile*> bestTerrainMatches(unsigned terrain,
+                                    unsigned considerationMask);
+
     /**
      * Add a new tile to the end of the tileset
      */
@@ -283,10 +297,20 @@ public:
      */
     void setTileImage(int index, const QPixmap &image);
 
+    /**
+     * Set a tile's image, computing its average color from \a image
+     * directly rather than from the pixmap made of it.
+     */
+    void setTileImage(int index, const QImage &image);
+
     /**
      * Used by the Tile class when its terrain information changes.
      */
-    void markTerrainDistancesDirty() { mTerrainDistancesDirty = true; }
+    void markTerrainDistancesDirty()
+    {
+        mTerrainDistancesDirty = true;
+        mTerrainIndexDirty = true;
+    }
 
 private:
     /**
@@ -301,10 +325,16 @@ private:
     void updateTileSize();
 
     /**
-     * Calculates the transition distance matrix for all terrain types.
+     * Calculates the transition distance matrix for all terrain types, which
+     * is stored as a flat (terrainCount() + 1)-square array.
      */
     void recalculateTerrainDistances();
 
+    /**
+     * Groups the tiles by their terrain and clears any cached matches.
+     */
+    void rebuildTerrainIndex();
+
     QString mName;
     QString mFileName;
     QString mImageSource;
@@ -319,7 +349,15 @@ private:
     int mColumnCount;
     QList<Tile*> mTiles;
     QList<Terrain*> mTerrainTypes;
+    QVector<int> mTerrainDistances;
     bool mTerrainDistancesDirty;
+
+    // Tiles grouped by their terrain, and the best matches found so far
+    // keyed on the terrain in the upper and the consideration mask in the
+    // lower 32 bits.
+    QHash<unsigned, QList<Tile*> > mTilesByTerrain;
+    QHash<quint64, QList<Tile*> > mTerrainMatches;
+    bool mTerrainIndexDirty;
 };
 
 } // namespace Tiled
@@ -0,0 +1,124 @@
+/*
+ * tilesetcache.cpp
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tilesetcache.h"
+
+#include "mapreader.h"
+#include "tileset.h"
+
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+using namespace Tiled;
+
+TilesetCache::TilesetCache()
+{
+}
+
+TilesetCache::~TilesetCache()
+{
+    clear();
+}
+
+Tileset *TilesetCache::tileset(const QString &fileName, QString *error)
+{
+    const QFileInfo fileInfo(fileName);
+    const QString canonicalPath = fileInfo.canonicalFilePath();
+
+    if (canonicalPath.isEmpty()) {
+        if (error)
+            *error = QCoreApplication::translate("MapReader",
+                                                 "File not found: %1")
+                    .arg(fileName);
+        return 0;
+    }
+
+    const QDateTime lastModified = fileInfo.lastModified();
+
+    QMutexLocker locker(&mMutex);
+
+    // A tileset that is being read by another thread is waited for, so that
+    // it is read only once. The lock is not held while reading, so that
+    // different tilesets can be read at the same time.
+    QHash<QString, Entry>::iterator it;
+    while ((it = mEntries.find(canonicalPath)) != mEntries.end()) {
+        if (!it.value().tileset) {
+            mTilesetRead.wait(&mMutex);
+            continue;
+        }
+
+        if (it.value().lastModified == lastModified)
+            return it.value().tileset;
+
+        mReplacedTilesets.append(it.value().tileset);
+        mEntries.erase(it);
+        break;
+    }
+
+    Entry entry;
+    entry.lastModified = lastModified;
+    entry.tileset = 0;
+    mEntries.insert(canonicalPath, entry);
+
+    locker.unlock();
+    MapReader reader;
+    Tileset *tileset = reader.readTileset(canonicalPath);
+    locker.relock();
+
+    if (tileset) {
+        mEntries[canonicalPath].tileset = tileset;
+        mTilesets.insert(tileset);
+    } else {
+        mEntries.remove(canonicalPath);
+        if (error)
+            *error = reader.errorString();
+    }
+
+    mTilesetRead.wakeAll();
+    return tileset;
+}
+
+bool TilesetCache::contains(const Tileset *tileset) const
+{
+    QMutexLocker locker(&mMutex);
+    return mTilesets.contains(tileset);
+}
+
+void TilesetCache::clear()
+{
+    QMutexLocker locker(&mMutex);
+
+    foreach (const Entry &entry, mEntries)
+        delete entry.tileset;
+    qDeleteAll(mReplacedTilesets);
+
+    mEntries.clear();
+    mTilesets.clear();
+    mReplacedTilesets.clear();
+}
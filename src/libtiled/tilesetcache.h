@@ -0,0 +1,108 @@
+/*
+ * tilesetcache.h
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TILESETCACHE_H
+#define TILESETCACHE_H
+
+#include "tiled_global.h"
+
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QWaitCondition>
+
+namespace Tiled {
+
+class Tileset;
+
+/**
+ * A cache of external tilesets, for tools that read many maps sharing the
+ * same tilesets. Each TSX file and its image is only read once, until the
+ * file is modified.
+ *
+ * Tilesets are identified by their canonical file path and modification
+ * time. The cache owns the tilesets it returns, so they should not be
+ * deleted along with the maps using them.
+ *
+ * The cache may be shared by readers on multiple threads.
+ *
+ * \sa MapReader::setTilesetCache()
+ */
+class TILEDSHARED_EXPORT TilesetCache
+{
+public:
+    TilesetCache();
+
+    /**
+     * Destructor. Deletes all tilesets owned by the cache.
+     */
+    ~TilesetCache();
+
+    /**
+     * Returns the tileset stored in the TSX file \a fileName, reading it when
+     * it is not cached yet or when the file changed since it was read.
+     *
+     * Returns 0 and sets \a error when the tileset could not be read.
+     */
+    Tileset *tileset(const QString &fileName, QString *error = 0);
+
+    /**
+     * Returns whether the given \a tileset is owned by this cache.
+     */
+    bool contains(const Tileset *tileset) const;
+
+    /**
+     * Deletes all tilesets owned by the cache. Should only be called when
+     * none of them are still in use.
+     */
+    void clear();
+
+private:
+    Q_DISABLE_COPY(TilesetCache)
+
+    struct Entry {
+        QDateTime lastModified;
+        Tileset *tileset;   // 0 while the tileset is being read
+    };
+
+    mutable QMutex mMutex;
+    QWaitCondition mTilesetRead;
+    QHash<QString, Entry> mEntries;
+
+    // All tilesets owned by the cache, including those that were replaced
+    // because their file changed, since they may still be in use
+    QSet<const Tileset*> mTilesets;
+    QList<Tileset*> mReplacedTilesets;
+};
+
+} // namespace Tiled
+
+#endif // TILESETCACHE_H
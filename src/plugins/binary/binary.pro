@@ -0,0 +1,8 @@
+include(../plugin.pri)
+
+DEFINES += BINARY_LIBRARY
+
+SOURCES += binaryplugin.cpp
+
+HEADERS += binaryplugin.h \
+    binary_global.h
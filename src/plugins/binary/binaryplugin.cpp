@@ -0,0 +1,70 @@
+/*
+ * Binary Map Tiled Plugin
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "binaryplugin.h"
+
+#include "binarymapreader.h"
+#include "binarymapwriter.h"
+
+using namespace Binary;
+
+BinaryPlugin::BinaryPlugin()
+{
+}
+
+Tiled::Map *BinaryPlugin::read(const QString &fileName)
+{
+    Tiled::BinaryMapReader reader;
+    Tiled::Map *map = reader.readMap(fileName);
+    if (!map)
+        mError = reader.errorString();
+
+    return map;
+}
+
+bool BinaryPlugin::write(const Tiled::Map *map, const QString &fileName)
+{
+    Tiled::BinaryMapWriter writer;
+    if (!writer.writeMap(map, fileName)) {
+        mError = writer.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+QString BinaryPlugin::nameFilter() const
+{
+    return tr("Tiled binary map files (*.tmb)");
+}
+
+bool BinaryPlugin::supportsFile(const QString &fileName) const
+{
+    return fileName.endsWith(QLatin1String(".tmb"), Qt::CaseInsensitive);
+}
+
+QString BinaryPlugin::errorString() const
+{
+    return mError;
+}
+
+#if QT_VERSION < 0x050000
+Q_EXPORT_PLUGIN2(Binary, BinaryPlugin)
+#endif
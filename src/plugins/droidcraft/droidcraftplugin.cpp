@@ -117,7 +117,7 @@ bool DroidcraftPlugin::write(const Tiled::Map *map, const QString &fileName)
 
     for (int y = 0; y < height; ++y) {
         for (int x = 0; x < width; ++x) {
-            if (Tile *tile = mapLayer->cellAt(x, y).tile)
+            if (Tile *tile = mapLayer->cellAt(x, y).tile())
                 uncompressed[y * width + x] = (unsigned char) tile->id();
         }
     }
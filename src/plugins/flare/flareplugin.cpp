@@ -309,7 +309,7 @@ bool FlarePlugin::write(const Tiled::Map *map, const QString &fileName)
                 for (int x = 0; x < mapWidth; ++x) {
                     Cell t = tileLayer->cellAt(x, y);
                     int id = 0;
-                    if (t.tile)
+                    if (t.tile())
                         id = gidMapper.cellToGid(t);
                     out << id;
                     if (x < mapWidth - 1)
@@ -1,5 +1,6 @@
 TEMPLATE = subdirs
-SUBDIRS = flare \
+SUBDIRS = binary \
+          flare \
           droidcraft \
           json \
           lua \
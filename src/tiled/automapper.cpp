@@ -38,10 +38,309 @@
 #include "tilesetmanager.h"
 
 #include <QDebug>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
 
 using namespace Tiled;
 using namespace Tiled::Internal;
 
+namespace Tiled {
+
+/**
+ * Allows cells to be stored in a QSet.
+ */
+static inline uint qHash(const Cell &cell)
+{
+    return ::qHash(reinterpret_cast<quintptr>(cell.tile()) | cell.flipFlags());
+}
+
+namespace Internal {
+
+/**
+ * The condition a rule places on a single position of a set layer.
+ */
+struct RuleCellCondition
+{
+    QPoint pos;
+    QSet<Cell> allowed;     // the non-empty cells of the listYes layers
+    QSet<Cell> forbidden;   // the non-empty cells of the listNo layers
+};
+
+/**
+ * The conditions a rule places on one set layer, compiled from the listYes
+ * and listNo layers of one of its input indexes.
+ */
+struct RuleLayerCondition
+{
+    QString layerName;
+    bool valid;             // false when the condition can never match
+    bool hasListYes;
+    bool hasListNo;
+    QSet<Cell> cellsYes;    // all cells of the listYes layers in the rule
+    QVector<RuleCellCondition> cells;
+    const TileLayer *setLayer;
+};
+
+/**
+ * A rule compiled from the input layers of the rules map, so that testing
+ * whether it matches comes down to a loop over the positions of the rule.
+ */
+class CompiledRule
+{
+public:
+    CompiledRule(const InputLayers &inputRules, const QRegion &ruleInput);
+
+    /**
+     * Looks up the set layers in the given \a map. Needs to be called
+     * before matches() whenever the layers of the map may have changed.
+     */
+    void resolveSetLayers(const Map *map);
+
+    /**
+     * Returns whether the rule matches the set layers at \a offset. The set
+     * layers are only read, so this may be called from several threads at
+     * once.
+     */
+    bool matches(const QPoint &offset) const;
+
+private:
+    // For each input index, the conditions on each of its set layers
+    QVector<QVector<RuleLayerCondition> > mIndexes;
+};
+
+} // namespace Internal
+} // namespace Tiled
+
+/**
+ * Compiles the conditions that the \a lists of layers for the set layer
+ * \a name place on the region \a ruleRegion. See compareLayerTo() for how
+ * these conditions are evaluated.
+ */
+static RuleLayerCondition compileLayerCondition(const QString &name,
+                                                const InputIndexName &lists,
+                                                const QRegion &ruleRegion)
+{
+    RuleLayerCondition condition;
+    condition.layerName = name;
+    condition.hasListYes = !lists.listYes.isEmpty();
+    condition.hasListNo = !lists.listNo.isEmpty();
+    condition.setLayer = 0;
+
+    // Without any layers, absolutely no condition is given. Assume this is
+    // an errornous rule.
+    condition.valid = condition.hasListYes || condition.hasListNo;
+
+    foreach (const QRect &rect, ruleRegion.rects()) {
+        for (int x = rect.left(); x <= rect.right(); ++x) {
+            for (int y = rect.top(); y <= rect.bottom(); ++y) {
+                RuleCellCondition cell;
+                cell.pos = QPoint(x, y);
+
+                foreach (const TileLayer *tileLayer, lists.listYes) {
+                    if (!tileLayer->contains(x, y)) {
+                        condition.valid = false;
+                        continue;
+                    }
+
+                    const Cell &c = tileLayer->cellAt(x, y);
+                    if (!c.isEmpty())
+                        cell.allowed.insert(c);
+
+                    // only needed for the exception when having only listYes
+                    if (!condition.hasListNo)
+                        condition.cellsYes.insert(c);
+                }
+                foreach (const TileLayer *tileLayer, lists.listNo) {
+                    if (!tileLayer->contains(x, y)) {
+                        condition.valid = false;
+                        continue;
+                    }
+
+                    const Cell &c = tileLayer->cellAt(x, y);
+                    if (!c.isEmpty())
+                        cell.forbidden.insert(c);
+                }
+
+                condition.cells.append(cell);
+            }
+        }
+    }
+
+    if (!condition.valid) {
+        condition.cells.clear();
+        condition.cellsYes.clear();
+    }
+
+    return condition;
+}
+
+/**
+ * This function is one of the core functions for understanding the
+ * automapping.
+ * In this function a certain region (of the set layer) is compared to
+ * several other layers (ruleSet and ruleNotSet), which were compiled into
+ * the given \a condition by compileLayerCondition().
+ * This comparision will determine if a rule of automapping matches,
+ * so if this rule is applied at this region given
+ * by a QRegion and Offset given by a QPoint.
+ *
+ * This compares the tile layer setLayer to several others given
+ * in the QList listYes (ruleSet) and OList listNo (ruleNotSet).
+ * The tile layer setLayer is examined at QRegion ruleRegion + offset
+ * The tile layers within listYes and listNo are examined at QRegion ruleRegion.
+ *
+ * Basically all matches between setLayer and a layer of listYes are considered
+ * good, while all matches between setLayer and listNo are considered bad and
+ * lead to canceling the comparison, returning false.
+ *
+ * The comparison is done for each position within the QRegion ruleRegion.
+ * If all positions of the region are considered "good" return true.
+ *
+ * Now there are several cases to distinguish:
+ *  - both listYes and listNo are empty:
+ *      This should not happen, because with that configuration, absolutely
+ *      no condition is given.
+ *      return false, assuming this is an errornous rule being applied
+ *
+ *  - both listYes and listNo are not empty:
+ *      When comparing a tile at a certain position of tile layer setLayer
+ *      to all available tiles in listYes, there must be at least
+ *      one layer, in which there is a match of tiles of setLayer and
+ *      listYes to consider this position good.
+ *      In listNo there must not be a match to consider this position
+ *      good.
+ *      If there are no tiles within all available tiles within all layers
+ *      of one list, all tiles in setLayer are considered good,
+ *      while inspecting this list.
+ *      All available tiles are all tiles within the whole rule region in
+ *      all tile layers of the list.
+ *
+ *  - either of both lists are not empty
+ *      When comparing a certain position of tile layer setLayer
+ *      to all Tiles at the corresponding position this can happen:
+ *      A tile of setLayer matches a tile of a layer in the list. Then this
+ *      is considered as good, if the layer is from the listYes.
+ *      Otherwise it is considered bad.
+ *
+ *      Exception, when having only the listYes:
+ *      if at the examined position there are no tiles within all Layers
+ *      of the listYes, all tiles except all used tiles within
+ *      the layers of that list are considered good.
+ *
+ *      This exception was added to have a better functionality
+ *      (need of less layers.)
+ *      It was not added to the case, when having only listNo layers to
+ *      avoid total symmetrie between those lists.
+ *
+ * If all positions are considered good, return true.
+ * return false otherwise.
+ *
+ * @return bool, if the tile layer matches the given list of layers.
+ */
+static bool compareLayerTo(const RuleLayerCondition &condition,
+                           const QPoint &offset)
+{
+    const TileLayer *setLayer = condition.setLayer;
+    if (!condition.valid || !setLayer)
+        return false;
+
+    const RuleCellCondition *cells = condition.cells.constData();
+    const int count = condition.cells.size();
+
+    for (int i = 0; i < count; ++i) {
+        const RuleCellCondition &cell = cells[i];
+        const int x = cell.pos.x() + offset.x();
+        const int y = cell.pos.y() + offset.y();
+
+        if (!setLayer->contains(x, y))
+            return false;
+
+        const Cell &c1 = setLayer->cellAt(x, y);
+        const bool matchListNo = cell.forbidden.contains(c1);
+
+        // when there are only layers in the listNo
+        // check only if these layers are unmatched
+        // no need to check explicitly the exception in this case.
+        if (!condition.hasListYes) {
+            if (matchListNo)
+                return false;
+            else
+                continue;
+        }
+
+        // ruleDefined is set when there is a tile in at least one layer of
+        // the listYes. In that case, only the given tiles are valid. If no
+        // tile is given at all in the listYes layers, consider all tiles
+        // valid.
+        const bool ruleDefinedListYes = !cell.allowed.isEmpty();
+        const bool matchListYes = cell.allowed.contains(c1);
+
+        // when there are only layers in the listYes
+        // check if these layers are matched, or if the exception works
+        if (!condition.hasListNo) {
+            if (matchListYes)
+                continue;
+            if (!ruleDefinedListYes && !condition.cellsYes.contains(c1))
+                continue;
+            return false;
+        }
+
+        // there are layers in both lists:
+        // no need to consider ruleDefinedListXXX
+        if ((matchListYes || !ruleDefinedListYes) && !matchListNo)
+            continue;
+        else
+            return false;
+    }
+    return true;
+}
+
+CompiledRule::CompiledRule(const InputLayers &inputRules,
+                           const QRegion &ruleInput)
+{
+    foreach (const QString &index, inputRules.indexes) {
+        const InputIndex &ii = *inputRules.constFind(index);
+
+        QVector<RuleLayerCondition> conditions;
+        foreach (const QString &name, ii.names)
+            conditions.append(compileLayerCondition(name, *ii.constFind(name),
+                                                    ruleInput));
+        mIndexes.append(conditions);
+    }
+}
+
+void CompiledRule::resolveSetLayers(const Map *map)
+{
+    for (int i = 0; i < mIndexes.size(); ++i) {
+        QVector<RuleLayerCondition> &conditions = mIndexes[i];
+        for (int j = 0; j < conditions.size(); ++j) {
+            RuleLayerCondition &condition = conditions[j];
+            const int index = map->indexOfLayer(condition.layerName,
+                                                Layer::TileLayerType);
+            condition.setLayer = index == -1 ? 0
+                                             : map->layerAt(index)->asTileLayer();
+        }
+    }
+}
+
+bool CompiledRule::matches(const QPoint &offset) const
+{
+    // The rule matches when all set layers of any input index match
+    foreach (const QVector<RuleLayerCondition> &conditions, mIndexes) {
+        bool allLayerNamesMatch = true;
+        foreach (const RuleLayerCondition &condition, conditions) {
+            if (!compareLayerTo(condition, offset)) {
+                allLayerNamesMatch = false;
+                break;
+            }
+        }
+        if (allLayerNamesMatch)
+            return true;
+    }
+    return false;
+}
+
 /*
  * About the order of the methods in this file.
  * The Automapper class has 3 bigger public functions, that is
@@ -323,6 +622,11 @@ bool AutoMapper::setupRuleList()
         Q_ASSERT(coherentRegions(checkCoherent).length() == 1);
     }
 
+    // Compile the input of each rule, so that it doesn't need to be looked
+    // up in the rule layers for every position it is tested at
+    foreach (const QRegion &ruleInput, mRulesInput)
+        mCompiledRules.append(new CompiledRule(mInputRules, ruleInput));
+
     return true;
 }
 
@@ -475,17 +779,24 @@ void AutoMapper::autoMap(QRegion *where)
         }
     }
 
+    // The positions where a rule matches can only be searched in parallel
+    // when applying the rule can't affect its own input. A single pool is
+    // used for all rules, so that its threads are only started once.
+    QThreadPool threadPool;
+    QThreadPool *matchPool = 0;
+    if (!outputAffectsInput() && QThread::idealThreadCount() > 1)
+        matchPool = &threadPool;
+
+    foreach (CompiledRule *rule, mCompiledRules)
+        rule->resolveSetLayers(mMapWork);
+
     // Increase the given region where the next automapper should work.
     // This needs to be done, so you can rely on the order of the rules at all
     // locations
     QRegion ret;
     foreach (const QRect &rect, where->rects())
-        for (int i = 0; i < mRulesInput.size(); ++i) {
-            // at the moment the parallel execution does not work yet
-            // TODO: make multithreading available!
-            // either by dividing the rules or the region to multiple threads
-            ret = ret.united(applyRule(i, rect));
-        }
+        for (int i = 0; i < mRulesInput.size(); ++i)
+            ret = ret.united(applyRule(i, rect, matchPool));
     *where = where->united(ret);
 }
 
@@ -502,12 +813,55 @@ const QRegion AutoMapper::getSetLayersRegion()
     return result;
 }
 
-static bool compareLayerTo(const TileLayer *setLayer,
-                           const QVector<TileLayer*> &listYes,
-                           const QVector<TileLayer*> &listNo,
-                           const QRegion &ruleRegion, const QPoint &offset);
+bool AutoMapper::outputAffectsInput() const
+{
+    foreach (const RuleOutput *translationTable, mLayerList) {
+        foreach (int index, translationTable->values()) {
+            const Layer *layer = mMapWork->layerAt(index);
+            if (layer->asTileLayer() && mInputRules.names.contains(layer->name()))
+                return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+// Below this number of candidate positions, rules are matched serially
+const int MinParallelPositions = 4096;
+
+/**
+ * Searches a band of candidate positions for matches of a rule, so that
+ * several bands can be searched in parallel on a QThreadPool.
+ */
+class RuleMatcher : public QRunnable
+{
+public:
+    RuleMatcher(const CompiledRule &rule, const QRect &positions)
+        : mRule(rule)
+        , mPositions(positions)
+    {}
+
+    void run()
+    {
+        for (int y = mPositions.top(); y <= mPositions.bottom(); ++y)
+            for (int x = mPositions.left(); x <= mPositions.right(); ++x)
+                if (mRule.matches(QPoint(x, y)))
+                    mMatches.append(QPoint(x, y));
+    }
+
+    const QVector<QPoint> &matches() const { return mMatches; }
+
+private:
+    const CompiledRule &mRule;
+    const QRect mPositions;
+    QVector<QPoint> mMatches;
+};
+
+} // anonymous namespace
 
-QRect AutoMapper::applyRule(const int ruleIndex, const QRect &where)
+QRect AutoMapper::applyRule(const int ruleIndex, const QRect &where,
+                            QThreadPool *threadPool)
 {
     QRect ret;
 
@@ -515,7 +869,7 @@ QRect AutoMapper::applyRule(const int ruleIndex, const QRect &where)
         return ret;
 
     const QRegion ruleInput = mRulesInput.at(ruleIndex);
-    const QRegion ruleOutput = mRulesOutput.at(ruleIndex);
+    const CompiledRule &rule = *mCompiledRules.at(ruleIndex);
     QRect rbr = ruleInput.boundingRect();
 
     // Since the rule itself is translated, we need to adjust the borders of the
@@ -536,254 +890,95 @@ QRect AutoMapper::applyRule(const int ruleIndex, const QRect &where)
         for (int i = 0; i < mMapWork->layerCount(); i++)
             appliedRegions.append(QRegion());
 
-    for (int y = minY; y <= maxY; ++y)
-    for (int x = minX; x <= maxX; ++x) {
-        bool anymatch = false;
-        foreach (const QString &index, mInputRules.indexes) {
-            const InputIndex &ii = mInputRules[index];
-
-            bool allLayerNamesMatch = true;
-            foreach (const QString &name, ii.names) {
-                const int i = mMapWork->indexOfLayer(name, Layer::TileLayerType);
-                if (i == -1) {
-                    allLayerNamesMatch = false;
-                } else {
-                    const TileLayer *setLayer = mMapWork->layerAt(i)->asTileLayer();
-                    allLayerNamesMatch &= compareLayerTo(setLayer,
-                                                         ii[name].listYes,
-                                                         ii[name].listNo,
-                                                         ruleInput,
-                                                         QPoint(x, y));
-                }
-            }
-            if (allLayerNamesMatch) {
-                anymatch = true;
-                break;
-            }
+    const int rows = maxY - minY + 1;
+    const int columns = maxX - minX + 1;
+
+    // When the rule doesn't change its own input, all the positions where it
+    // matches can be found up front. They are then applied in the same order
+    // as when matching and applying position by position.
+    if (threadPool && rows > 1 && rows * columns >= MinParallelPositions) {
+        const int bandCount = qMin(rows, threadPool->maxThreadCount() * 4);
+        QList<RuleMatcher*> matchers;
+
+        for (int i = 0; i < bandCount; ++i) {
+            const int top = minY + rows * i / bandCount;
+            const int bottom = minY + rows * (i + 1) / bandCount - 1;
+            RuleMatcher *matcher = new RuleMatcher(rule,
+                                                   QRect(QPoint(minX, top),
+                                                         QPoint(maxX, bottom)));
+            matcher->setAutoDelete(false);
+            matchers.append(matcher);
+            threadPool->start(matcher);
         }
 
-        if (anymatch) {
-            int r = 0;
-            // choose by chance which group of rule_layers should be used:
-            if (mLayerList.size() > 1)
-                r = qrand() % mLayerList.size();
-
-            if (!mNoOverlappingRules) {
-                copyMapRegion(ruleOutput, QPoint(x, y), mLayerList.at(r));
-                ret = ret.united(rbr.translated(QPoint(x, y)));
-                continue;
-            }
+        threadPool->waitForDone();
 
-            bool missmatch = false;
-            RuleOutput *translationTable = mLayerList.at(r);
-            QList<Layer*> layers = translationTable->keys();
+        QVector<QPoint> matches;
+        foreach (const RuleMatcher *matcher, matchers)
+            matches += matcher->matches();
+        qDeleteAll(matchers);
 
-            // check if there are no overlaps within this rule.
-            QVector<QRegion> ruleRegionInLayer;
-            for (int i = 0; i < layers.size(); ++i) {
-                Layer *layer = layers.at(i);
+        foreach (const QPoint &pos, matches)
+            applyRuleAt(ruleIndex, pos, appliedRegions, ret);
 
-                QRegion appliedPlace;
-                TileLayer *tileLayer = layer->asTileLayer();
-                if (tileLayer)
-                    appliedPlace = tileLayer->region();
-                else
-                    appliedPlace = tileRegionOfObjectGroup(layer->asObjectGroup());
-
-                ruleRegionInLayer.append(appliedPlace.intersected(ruleOutput));
-                if (appliedRegions.at(i).intersects(
-                            ruleRegionInLayer[i].translated(x, y))) {
-                    missmatch = true;
-                    break;
-                }
-            }
-            if (missmatch)
-                continue;
-
-            copyMapRegion(ruleOutput, QPoint(x, y), mLayerList.at(r));
-            ret = ret.united(rbr.translated(QPoint(x, y)));
-            for (int i = 0; i < translationTable->size(); ++i) {
-                appliedRegions[i] +=
-                        ruleRegionInLayer[i].translated(x, y);
-            }
-        }
+        return ret;
     }
 
-    return ret;
-}
+    for (int y = minY; y <= maxY; ++y)
+        for (int x = minX; x <= maxX; ++x)
+            if (rule.matches(QPoint(x, y)))
+                applyRuleAt(ruleIndex, QPoint(x, y), appliedRegions, ret);
 
-/**
- * Returns a list of all cells which can be found within all tile layers
- * within the given region.
- */
-static QVector<Cell> cellsInRegion(const QVector<TileLayer*> &list,
-                                   const QRegion &r)
-{
-    QVector<Cell> cells;
-    foreach (const TileLayer *tilelayer, list) {
-        foreach (const QRect &rect, r.rects()) {
-            for (int x = rect.left(); x <= rect.right(); ++x) {
-                for (int y = rect.top(); y <= rect.bottom(); ++y) {
-                    const Cell &cell = tilelayer->cellAt(x, y);
-                    if (!cells.contains(cell))
-                        cells.append(cell);
-                }
-            }
-        }
-    }
-    return cells;
+    return ret;
 }
 
-/**
- * This function is one of the core functions for understanding the
- * automapping.
- * In this function a certain region (of the set layer) is compared to
- * several other layers (ruleSet and ruleNotSet).
- * This comparision will determine if a rule of automapping matches,
- * so if this rule is applied at this region given
- * by a QRegion and Offset given by a QPoint.
- *
- * This compares the tile layer setLayer to several others given
- * in the QList listYes (ruleSet) and OList listNo (ruleNotSet).
- * The tile layer setLayer is examined at QRegion ruleRegion + offset
- * The tile layers within listYes and listNo are examined at QRegion ruleRegion.
- *
- * Basically all matches between setLayer and a layer of listYes are considered
- * good, while all matches between setLayer and listNo are considered bad and
- * lead to canceling the comparison, returning false.
- *
- * The comparison is done for each position within the QRegion ruleRegion.
- * If all positions of the region are considered "good" return true.
- *
- * Now there are several cases to distinguish:
- *  - both listYes and listNo are empty:
- *      This should not happen, because with that configuration, absolutely
- *      no condition is given.
- *      return false, assuming this is an errornous rule being applied
- *
- *  - both listYes and listNo are not empty:
- *      When comparing a tile at a certain position of tile layer setLayer
- *      to all available tiles in listYes, there must be at least
- *      one layer, in which there is a match of tiles of setLayer and
- *      listYes to consider this position good.
- *      In listNo there must not be a match to consider this position
- *      good.
- *      If there are no tiles within all available tiles within all layers
- *      of one list, all tiles in setLayer are considered good,
- *      while inspecting this list.
- *      All available tiles are all tiles within the whole rule region in
- *      all tile layers of the list.
- *
- *  - either of both lists are not empty
- *      When comparing a certain position of tile layer setLayer
- *      to all Tiles at the corresponding position this can happen:
- *      A tile of setLayer matches a tile of a layer in the list. Then this
- *      is considered as good, if the layer is from the listYes.
- *      Otherwise it is considered bad.
- *
- *      Exception, when having only the listYes:
- *      if at the examined position there are no tiles within all Layers
- *      of the listYes, all tiles except all used tiles within
- *      the layers of that list are considered good.
- *
- *      This exception was added to have a better functionality
- *      (need of less layers.)
- *      It was not added to the case, when having only listNo layers to
- *      avoid total symmetrie between those lists.
- *
- * If all positions are considered good, return true.
- * return false otherwise.
- *
- * @return bool, if the tile layer matches the given list of layers.
- */
-static bool compareLayerTo(const TileLayer *setLayer,
-                           const QVector<TileLayer*> &listYes,
-                           const QVector<TileLayer*> &listNo,
-                           const QRegion &ruleRegion, const QPoint &offset)
+void AutoMapper::applyRuleAt(int ruleIndex, const QPoint &pos,
+                             QList<QRegion> &appliedRegions, QRect &applied)
 {
-    if (listYes.isEmpty() && listNo.isEmpty())
-        return false;
-
-    QVector<Cell> cells;
-    if (listYes.isEmpty())
-        cells = cellsInRegion(listNo, ruleRegion);
-    if (listNo.isEmpty())
-        cells = cellsInRegion(listYes, ruleRegion);
-
-    foreach (const QRect &rect, ruleRegion.rects()) {
-        for (int x = rect.left(); x <= rect.right(); ++x) {
-            for (int y = rect.top(); y <= rect.bottom(); ++y) {
-                // this is only used in the case where only one list has layers
-                // it is needed for the exception mentioned above
-                bool ruleDefinedListYes = false;
-
-                bool matchListYes = false;
-                bool matchListNo  = false;
-
-                if (!setLayer->contains(x + offset.x(), y + offset.y()))
-                    return false;
-
-                const Cell &c1 = setLayer->cellAt(x + offset.x(),
-                                                  y + offset.y());
-
-                // ruleDefined will be set when there is a tile in at least
-                // one layer. if there is a tile in at least one layer, only
-                // the given tiles in the different listYes layers are valid.
-                // if there is given no tile at all in the listYes layers,
-                // consider all tiles valid.
-
-                foreach (const TileLayer *comparedTileLayer, listYes) {
-
-                    if (!comparedTileLayer->contains(x, y))
-                        return false;
-
-                    const Cell &c2 = comparedTileLayer->cellAt(x, y);
-                    if (!c2.isEmpty())
-                        ruleDefinedListYes = true;
-
-                    if (!c2.isEmpty() && c1 == c2)
-                        matchListYes = true;
-                }
-                foreach (const TileLayer *comparedTileLayer, listNo) {
-
-                    if (!comparedTileLayer->contains(x, y))
-                        return false;
-
-                    const Cell &c2 = comparedTileLayer->cellAt(x, y);
-
-                    if (!c2.isEmpty() && c1 == c2)
-                        matchListNo = true;
-                }
-
-                // when there are only layers in the listNo
-                // check only if these layers are unmatched
-                // no need to check explicitly the exception in this case.
-                if (listYes.isEmpty()) {
-                    if (matchListNo)
-                        return false;
-                    else
-                        continue;
-                }
-                // when there are only layers in the listYes
-                // check if these layers are matched, or if the exception works
-                if (listNo.isEmpty()) {
-                    if (matchListYes)
-                        continue;
-                    if (!ruleDefinedListYes && !cells.contains(c1))
-                        continue;
-                    return false;
-                }
+    const QRegion &ruleOutput = mRulesOutput.at(ruleIndex);
+    const QRect rbr = mRulesInput.at(ruleIndex).boundingRect();
+    const int x = pos.x();
+    const int y = pos.y();
+
+    int r = 0;
+    // choose by chance which group of rule_layers should be used:
+    if (mLayerList.size() > 1)
+        r = qrand() % mLayerList.size();
+
+    if (!mNoOverlappingRules) {
+        copyMapRegion(ruleOutput, pos, mLayerList.at(r));
+        applied = applied.united(rbr.translated(pos));
+        return;
+    }
 
-                // there are layers in both lists:
-                // no need to consider ruleDefinedListXXX
-                if ((matchListYes || !ruleDefinedListYes) && !matchListNo)
-                    continue;
-                else
-                    return false;
-            }
+    RuleOutput *translationTable = mLayerList.at(r);
+    QList<Layer*> layers = translationTable->keys();
+
+    // check if there are no overlaps within this rule.
+    QVector<QRegion> ruleRegionInLayer;
+    for (int i = 0; i < layers.size(); ++i) {
+        Layer *layer = layers.at(i);
+
+        QRegion appliedPlace;
+        TileLayer *tileLayer = layer->asTileLayer();
+        if (tileLayer)
+            appliedPlace = tileLayer->region();
+        else
+            appliedPlace = tileRegionOfObjectGroup(layer->asObjectGroup());
+
+        ruleRegionInLayer.append(appliedPlace.intersected(ruleOutput));
+        if (appliedRegions.at(i).intersects(
+                    ruleRegionInLayer[i].translated(x, y))) {
+            return;
         }
     }
-    return true;
+
+    copyMapRegion(ruleOutput, pos, mLayerList.at(r));
+    applied = applied.united(rbr.translated(pos));
+    for (int i = 0; i < translationTable->size(); ++i) {
+        appliedRegions[i] +=
+                ruleRegionInLayer[i].translated(x, y);
+    }
 }
 
 void AutoMapper::copyMapRegion(const QRegion &region, QPoint offset,
@@ -913,6 +1108,8 @@ void AutoMapper::cleanUpRulesMap()
     mMapRules = 0;
 
     cleanUpRuleMapLayers();
+    qDeleteAll(mCompiledRules);
+    mCompiledRules.clear();
     mRulesInput.clear();
     mRulesOutput.clear();
 }
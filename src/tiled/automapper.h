@@ -30,6 +30,8 @@
 #include <QString>
 #include <QVector>
 
+class QThreadPool;
+
 namespace Tiled {
 
 class Layer;
@@ -41,6 +43,7 @@ class Tileset;
 
 namespace Internal {
 
+class CompiledRule;
 class MapDocument;
 
 class InputIndexName
@@ -233,9 +236,27 @@ private:
      * if there is a match all Layers are copied to mMapWork.
      * @param ruleIndex: the region which should be compared to all positions
      *              of mMapWork will be looked up in mRulesInput and mRulesOutput
+     * @param threadPool: when given, the positions where the rule matches
+     *              are searched for in parallel on this pool
      * @return where: an rectangle where the rule actually got applied
      */
-    QRect applyRule(const int ruleIndex, const QRect &where);
+    QRect applyRule(const int ruleIndex, const QRect &where,
+                    QThreadPool *threadPool);
+
+    /**
+     * Applies the rule at \a ruleIndex at the position \a pos, where it was
+     * found to match. Unless overlapping is allowed, the rule is skipped when
+     * it would overlap the \a appliedRegions of earlier applications. The
+     * area that got changed is added to \a applied.
+     */
+    void applyRuleAt(int ruleIndex, const QPoint &pos,
+                     QList<QRegion> &appliedRegions, QRect &applied);
+
+    /**
+     * Returns whether any of the output layers is also used as input layer,
+     * in which case applying a rule may change where it matches.
+     */
+    bool outputAffectsInput() const;
 
     /**
      * Cleans up the data structes filled by setupRuleMapLayers(),
@@ -314,6 +335,12 @@ private:
      */
     QList<QRegion> mRulesOutput;
 
+    /**
+     * The rules compiled from mRulesInput and mInputRules, with matching
+     * indexes. Set up by setupRuleList().
+     */
+    QList<CompiledRule*> mCompiledRules;
+
     /**
      * The inner set with layers to indexes is needed for translating
      * tile layers from mMapRules to mMapWork.
@@ -130,5 +130,5 @@ void AutoMapperWrapper::patchLayer(int layerIndex, TileLayer *layer)
 
     t->setCells(b.left() - t->x(), b.top() - t->y(), layer,
                 b.translated(-t->position()));
-    mMapDocument->emitRegionChanged(b);
+    mMapDocument->emitRegionChanged(b, t);
 }
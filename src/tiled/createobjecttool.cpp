@@ -149,7 +149,7 @@ void CreateObjectTool::mouseMoved(const QPointF &pos,
         break;
     }
     case CreateTile: {
-        const QSize imgSize = mNewMapObjectItem->mapObject()->cell().tile->size();
+        const QSize imgSize = mNewMapObjectItem->mapObject()->cell().tile()->size();
         const QPointF diff(-imgSize.width() / 2, imgSize.height() / 2);
         QPointF tileCoords = renderer->pixelToTileCoords(pos + diff);
 
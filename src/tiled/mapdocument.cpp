@@ -527,9 +527,9 @@ void MapDocument::emitMapChanged()
     emit mapChanged();
 }
 
-void MapDocument::emitRegionChanged(const QRegion &region)
+void MapDocument::emitRegionChanged(const QRegion &region, Layer *layer)
 {
-    emit regionChanged(region);
+    emit regionChanged(region, layer);
 }
 
 void MapDocument::emitRegionEdited(const QRegion &region, Layer *layer)
@@ -221,9 +221,11 @@ public:
 
     /**
      * Emits the region changed signal for the specified region. The region
-     * should be in tile coordinates. This method is used by the TilePainter.
+     * should be in tile coordinates. When the change is limited to a single
+     * layer, it should be passed as \a layer. This method is used by the
+     * TilePainter.
      */
-    void emitRegionChanged(const QRegion &region);
+    void emitRegionChanged(const QRegion &region, Layer *layer = 0);
 
     /**
      * Emits the region edited signal for the specified region and tile layer.
@@ -284,9 +286,10 @@ signals:
 
     /**
      * Emitted when a certain region of the map changes. The region is given in
-     * tile coordinates.
+     * tile coordinates. The \a layer is the only layer that changed, or 0
+     * when any number of layers may have changed.
      */
-    void regionChanged(const QRegion &region);
+    void regionChanged(const QRegion &region, Layer *layer);
 
     /**
      * Emitted when a certain region of the map was edited by user input.
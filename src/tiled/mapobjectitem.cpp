@@ -306,7 +306,7 @@ void MapObjectItem::paint(QPainter *painter,
 QPointF MapObjectItem::objectCenter() const
 {
     if (!mObject->cell().isEmpty()) {
-        const QSize tileSize = mObject->cell().tile->size();
+        const QSize tileSize = mObject->cell().tile()->size();
         return QPointF(tileSize.width() / 2,
                        -tileSize.height() / 2);
     }
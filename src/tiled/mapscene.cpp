@@ -76,6 +76,10 @@ MapScene::MapScene(QObject *parent):
     connect(prefs, SIGNAL(objectTypesChanged()), SLOT(syncAllObjectItems()));
     connect(prefs, SIGNAL(highlightCurrentLayerChanged(bool)),
             SLOT(setHighlightCurrentLayer(bool)));
+    connect(prefs, SIGNAL(cacheTileLayersChanged(bool)),
+            SLOT(setCacheTileLayers(bool)));
+    connect(prefs, SIGNAL(lowDetailZoomChanged(int)),
+            SLOT(setLowDetailZoom(int)));
     connect(prefs, SIGNAL(gridColorChanged(QColor)), SLOT(update()));
 
     mDarkRectangle->setPen(Qt::NoPen);
@@ -86,6 +90,8 @@ MapScene::MapScene(QObject *parent):
     mGridVisible = prefs->showGrid();
     mShowTileObjectOutlines = prefs->showTileObjectOutlines();
     mHighlightCurrentLayer = prefs->highlightCurrentLayer();
+    mCacheTileLayers = prefs->cacheTileLayers();
+    mLowDetailZoom = prefs->lowDetailZoom();
 
     // Install an event filter so that we can get key events on behalf of the
     // active tool without having to have the current focus.
@@ -109,11 +115,14 @@ void MapScene::setMapDocument(MapDocument *mapDocument)
     if (mMapDocument) {
         MapRenderer *renderer = mMapDocument->renderer();
         renderer->setFlag(ShowTileObjectOutlines, mShowTileObjectOutlines);
+        renderer->setLevelOfDetailThreshold(mLowDetailZoom / qreal(100));
 
         connect(mMapDocument, SIGNAL(mapChanged()),
                 this, SLOT(mapChanged()));
-        connect(mMapDocument, SIGNAL(regionChanged(QRegion)),
-                this, SLOT(repaintRegion(QRegion)));
+        connect(mMapDocument, SIGNAL(regionChanged(QRegion,Layer*)),
+                this, SLOT(repaintRegion(QRegion,Layer*)));
+        connect(mMapDocument, SIGNAL(tilesetRemoved(Tileset*)),
+                this, SLOT(tilesetRemoved()));
         connect(mMapDocument, SIGNAL(layerAdded(int)),
                 this, SLOT(layerAdded(int)));
         connect(mMapDocument, SIGNAL(layerRemoved(int)),
@@ -197,7 +206,9 @@ QGraphicsItem *MapScene::createLayerItem(Layer *layer)
     QGraphicsItem *layerItem = 0;
 
     if (TileLayer *tl = layer->asTileLayer()) {
-        layerItem = new TileLayerItem(tl, mMapDocument->renderer());
+        TileLayerItem *tlItem = new TileLayerItem(tl, mMapDocument->renderer());
+        tlItem->setCacheEnabled(mCacheTileLayers);
+        layerItem = tlItem;
     } else if (ObjectGroup *og = layer->asObjectGroup()) {
         ObjectGroupItem *ogItem = new ObjectGroupItem(og);
         foreach (MapObject *object, og->objects()) {
@@ -247,8 +258,35 @@ void MapScene::updateCurrentLayerHighlight()
     }
 }
 
-void MapScene::repaintRegion(const QRegion &region)
+/**
+ * Discards the cached chunks of all tile layers that overlap the given
+ * \a region, in tile coordinates. An empty region discards everything.
+ */
+void MapScene::invalidateTileLayerCaches(const QRegion &region)
 {
+    foreach (QGraphicsItem *item, mLayerItems) {
+        if (TileLayerItem *tli = dynamic_cast<TileLayerItem*>(item)) {
+            if (region.isEmpty())
+                tli->invalidateCache();
+            else
+                tli->invalidateCache(region);
+        }
+    }
+}
+
+void MapScene::repaintRegion(const QRegion &region, Layer *layer)
+{
+    if (!layer) {
+        invalidateTileLayerCaches(region);
+    } else {
+        const int index = mMapDocument->map()->layers().indexOf(layer);
+        if (index != -1) {
+            QGraphicsItem *item = mLayerItems.at(index);
+            if (TileLayerItem *tli = dynamic_cast<TileLayerItem*>(item))
+                tli->invalidateCache(region);
+        }
+    }
+
     const MapRenderer *renderer = mMapDocument->renderer();
     const QMargins margins = mMapDocument->map()->drawMargins();
 
@@ -320,8 +358,16 @@ void MapScene::tilesetChanged(Tileset *tileset)
     if (!mMapDocument)
         return;
 
-    if (mMapDocument->map()->tilesets().contains(tileset))
+    if (mMapDocument->map()->tilesets().contains(tileset)) {
+        invalidateTileLayerCaches();
         update();
+    }
+}
+
+void MapScene::tilesetRemoved()
+{
+    invalidateTileLayerCaches();
+    update();
 }
 
 void MapScene::layerAdded(int index)
@@ -473,6 +519,35 @@ void MapScene::setHighlightCurrentLayer(bool highlightCurrentLayer)
     updateCurrentLayerHighlight();
 }
 
+void MapScene::setCacheTileLayers(bool cacheTileLayers)
+{
+    if (mCacheTileLayers == cacheTileLayers)
+        return;
+
+    mCacheTileLayers = cacheTileLayers;
+
+    foreach (QGraphicsItem *item, mLayerItems)
+        if (TileLayerItem *tli = dynamic_cast<TileLayerItem*>(item))
+            tli->setCacheEnabled(mCacheTileLayers);
+}
+
+void MapScene::setLowDetailZoom(int lowDetailZoom)
+{
+    if (mLowDetailZoom == lowDetailZoom)
+        return;
+
+    mLowDetailZoom = lowDetailZoom;
+
+    if (mMapDocument) {
+        MapRenderer *renderer = mMapDocument->renderer();
+        renderer->setLevelOfDetailThreshold(mLowDetailZoom / qreal(100));
+
+        // The cached chunks may have been drawn at the other level of detail
+        invalidateTileLayerCaches();
+        update();
+    }
+}
+
 void MapScene::drawForeground(QPainter *painter, const QRectF &rect)
 {
     if (!mMapDocument || !mGridVisible)
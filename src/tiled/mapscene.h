@@ -139,20 +139,34 @@ private slots:
      */
     void setHighlightCurrentLayer(bool highlightCurrentLayer);
 
+    /**
+     * Sets whether tile layers are drawn from a cache of pre-rendered chunks.
+     */
+    void setCacheTileLayers(bool cacheTileLayers);
+
+    /**
+     * Sets the zoom level in percent below which tile layers are drawn at a
+     * low level of detail. 0 disables drawing at a low level of detail.
+     */
+    void setLowDetailZoom(int lowDetailZoom);
+
     /**
      * Refreshes the map scene.
      */
     void refreshScene();
 
     /**
-     * Repaints the specified region. The region is in tile coordinates.
+     * Repaints the specified region. The region is in tile coordinates. Only
+     * the cached chunks of the given \a layer are discarded, or those of all
+     * tile layers when it is 0.
      */
-    void repaintRegion(const QRegion &region);
+    void repaintRegion(const QRegion &region, Layer *layer);
 
     void currentLayerIndexChanged();
 
     void mapChanged();
     void tilesetChanged(Tileset *tileset);
+    void tilesetRemoved();
 
     void layerAdded(int index);
     void layerRemoved(int index);
@@ -169,6 +183,7 @@ private:
     QGraphicsItem *createLayerItem(Layer *layer);
 
     void updateCurrentLayerHighlight();
+    void invalidateTileLayerCaches(const QRegion &region = QRegion());
 
     bool eventFilter(QObject *object, QEvent *event);
 
@@ -178,6 +193,8 @@ private:
     bool mGridVisible;
     bool mShowTileObjectOutlines;
     bool mHighlightCurrentLayer;
+    bool mCacheTileLayers;
+    int mLowDetailZoom;
     bool mUnderMouse;
     Qt::KeyboardModifiers mCurrentModifiers;
     QPointF mLastMousePos;
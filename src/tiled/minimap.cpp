@@ -32,22 +32,32 @@
 #include "objectgroup.h"
 #include "preferences.h"
 #include "tilelayer.h"
+#include "tilesetmanager.h"
 #include "zoomable.h"
 
 #include <QCursor>
 #include <QPainter>
 #include <QResizeEvent>
 #include <QScrollBar>
-#include <QUndoStack>
+#include <QTime>
+#include <QtCore/qmath.h>
 
 using namespace Tiled;
 using namespace Tiled::Internal;
 
+// The height of the bands in which the minimap image is rendered, in pixels
+static const int renderBandHeight = 32;
+
+// The time after which rendering yields to the event loop, in milliseconds
+static const int renderTimeSlice = 20;
+
 MiniMap::MiniMap(QWidget *parent)
     : QFrame(parent)
     , mMapDocument(0)
+    , mMapImageScale(0)
     , mDragging(false)
     , mMouseMoveCursorState(false)
+    , mRedrawMapImage(true)
     , mRenderFlags(DrawTiles | DrawObjects | DrawImages | IgnoreInvisibleLayer)
 {
     setFrameStyle(QFrame::StyledPanel | QFrame::Sunken);
@@ -59,6 +69,11 @@ MiniMap::MiniMap(QWidget *parent)
     mMapImageUpdateTimer.setSingleShot(true);
     connect(&mMapImageUpdateTimer, SIGNAL(timeout()),
             SLOT(redrawTimeout()));
+
+    connect(TilesetManager::instance(), SIGNAL(tilesetChanged(Tileset*)),
+            SLOT(scheduleMapImageUpdate()));
+    connect(Preferences::instance(), SIGNAL(objectTypesChanged()),
+            SLOT(scheduleMapImageUpdate()));
 }
 
 void MiniMap::setMapDocument(MapDocument *map)
@@ -78,7 +93,25 @@ void MiniMap::setMapDocument(MapDocument *map)
     mMapDocument = map;
 
     if (mMapDocument) {
-        connect(mMapDocument->undoStack(), SIGNAL(indexChanged(int)),
+        connect(mMapDocument, SIGNAL(regionChanged(QRegion,Layer*)),
+                this, SLOT(regionChanged(QRegion)));
+        connect(mMapDocument, SIGNAL(objectsAdded(QList<MapObject*>)),
+                this, SLOT(objectsAdded(QList<MapObject*>)));
+        connect(mMapDocument, SIGNAL(objectsChanged(QList<MapObject*>)),
+                this, SLOT(objectsChanged(QList<MapObject*>)));
+        connect(mMapDocument, SIGNAL(objectsRemoved(QList<MapObject*>)),
+                this, SLOT(objectsRemoved(QList<MapObject*>)));
+
+        // Changes that may affect the whole map cause a full redraw
+        connect(mMapDocument, SIGNAL(mapChanged()),
+                this, SLOT(scheduleMapImageUpdate()));
+        connect(mMapDocument, SIGNAL(layerAdded(int)),
+                this, SLOT(scheduleMapImageUpdate()));
+        connect(mMapDocument, SIGNAL(layerRemoved(int)),
+                this, SLOT(scheduleMapImageUpdate()));
+        connect(mMapDocument, SIGNAL(layerChanged(int)),
+                this, SLOT(scheduleMapImageUpdate()));
+        connect(mMapDocument, SIGNAL(tilesetRemoved(Tileset*)),
                 this, SLOT(scheduleMapImageUpdate()));
 
         if (MapView *mapView = dm->viewForDocument(mMapDocument)) {
@@ -98,6 +131,7 @@ QSize MiniMap::sizeHint() const
 
 void MiniMap::scheduleMapImageUpdate()
 {
+    mRedrawMapImage = true;
     mMapImageUpdateTimer.start(100);
 }
 
@@ -105,11 +139,6 @@ void MiniMap::paintEvent(QPaintEvent *pe)
 {
     QFrame::paintEvent(pe);
 
-    if (mRedrawMapImage) {
-        renderMapToImage();
-        mRedrawMapImage = false;
-    }
-
     if (mMapImage.isNull() || mImageRect.isEmpty())
         return;
 
@@ -168,10 +197,18 @@ static bool objectLessThan(const MapObject *a, const MapObject *b)
     return a->y() < b->y();
 }
 
-void MiniMap::renderMapToImage()
+/**
+ * Allocates the minimap image for the current size and marks the whole map
+ * as needing to be rendered.
+ */
+void MiniMap::resetMapImage()
 {
+    mDirtyArea = QRegion();
+    mObjectRects.clear();
+
     if (!mMapDocument) {
         mMapImage = QImage();
+        updateImageRect();
         return;
     }
 
@@ -181,15 +218,16 @@ void MiniMap::renderMapToImage()
 
     if (mapSize.isEmpty()) {
         mMapImage = QImage();
+        updateImageRect();
         return;
     }
 
     // Determine the largest possible scale
-    qreal scale = qMin((qreal) r.width() / mapSize.width(),
-                       (qreal) r.height() / mapSize.height());
+    mMapImageScale = qMin((qreal) r.width() / mapSize.width(),
+                          (qreal) r.height() / mapSize.height());
 
     // Allocate a new image when the size changed
-    const QSize imageSize = mapSize * scale;
+    const QSize imageSize = mapSize * mMapImageScale;
     if (mMapImage.size() != imageSize) {
         mMapImage = QImage(imageSize, QImage::Format_ARGB32);
         updateImageRect();
@@ -198,18 +236,160 @@ void MiniMap::renderMapToImage()
     if (imageSize.isEmpty())
         return;
 
+    mMapImage.fill(Qt::transparent);
+    mDirtyArea = QRect(QPoint(), mapSize);
+
+    // Remember where the objects are, to know what to redraw when they change
+    foreach (ObjectGroup *objectGroup, mMapDocument->map()->objectGroups())
+        foreach (MapObject *object, objectGroup->objects())
+            mObjectRects.insert(object, objectRect(object));
+}
+
+/**
+ * Marks the given \a area, in map pixels, as needing to be rendered again.
+ */
+void MiniMap::invalidateArea(const QRect &area)
+{
+    if (area.isEmpty() || mMapImage.isNull())
+        return;
+
+    mDirtyArea |= area;
+
+    if (!mMapImageUpdateTimer.isActive())
+        mMapImageUpdateTimer.start(100);
+}
+
+/**
+ * Returns the area covered by the \a object, including its name.
+ */
+QRectF MiniMap::objectRect(const MapObject *object) const
+{
+    const QRectF bounds = mMapDocument->renderer()->boundingRect(object);
+    if (object->name().isEmpty())
+        return bounds.adjusted(-2, -2, 2, 2);
+
+    const QFontMetrics metrics = fontMetrics();
+    return bounds.adjusted(-2, -metrics.height() - 5,
+                           metrics.width(object->name()) + 2, 2);
+}
+
+void MiniMap::regionChanged(const QRegion &region)
+{
+    const MapRenderer *renderer = mMapDocument->renderer();
+    const QMargins margins = mMapDocument->map()->drawMargins();
+
+    foreach (const QRect &r, region.rects()) {
+        invalidateArea(renderer->boundingRect(r).adjusted(-margins.left(),
+                                                          -margins.top(),
+                                                          margins.right(),
+                                                          margins.bottom()));
+    }
+}
+
+void MiniMap::objectsAdded(const QList<MapObject*> &objects)
+{
+    foreach (MapObject *object, objects) {
+        const QRectF rect = objectRect(object);
+        mObjectRects.insert(object, rect);
+        invalidateArea(rect.toAlignedRect());
+    }
+}
+
+void MiniMap::objectsChanged(const QList<MapObject*> &objects)
+{
+    foreach (MapObject *object, objects) {
+        const QRectF rect = objectRect(object);
+        invalidateArea(mObjectRects.value(object).toAlignedRect());
+        invalidateArea(rect.toAlignedRect());
+        mObjectRects.insert(object, rect);
+    }
+}
+
+void MiniMap::objectsRemoved(const QList<MapObject*> &objects)
+{
+    foreach (MapObject *object, objects)
+        invalidateArea(mObjectRects.take(object).toAlignedRect());
+}
+
+/**
+ * Renders the dirty area into the minimap image. The area is rendered in
+ * horizontal bands, and rendering continues later from the event loop when
+ * it takes too long, so that even a huge map does not block the UI.
+ */
+void MiniMap::renderDirtyArea()
+{
+    if (mMapImage.isNull()) {
+        mDirtyArea = QRegion();
+        return;
+    }
+
+    const int bandHeight = qMax(1, qCeil(renderBandHeight / mMapImageScale));
+
+    QTime time;
+    time.start();
+
+    while (!mDirtyArea.isEmpty()) {
+        QRect band = mDirtyArea.rects().first();
+        if (band.height() > bandHeight)
+            band.setHeight(bandHeight);
+
+        renderArea(band);
+        mDirtyArea -= band;
+
+        if (time.elapsed() >= renderTimeSlice)
+            break;
+    }
+
+    if (!mDirtyArea.isEmpty())
+        mMapImageUpdateTimer.start(0);
+}
+
+/**
+ * Renders the given \a area, in map pixels, into the minimap image.
+ */
+void MiniMap::renderArea(const QRect &area)
+{
+    MapRenderer *renderer = mMapDocument->renderer();
+    const qreal scale = mMapImageScale;
+
+    // Determine the image pixels touched by the area and the part of the
+    // map they cover
+    const QRect imageArea = QRectF(area.x() * scale,
+                                   area.y() * scale,
+                                   area.width() * scale,
+                                   area.height() * scale).toAlignedRect()
+            & mMapImage.rect();
+
+    if (imageArea.isEmpty())
+        return;
+
+    const QRectF exposed(imageArea.x() / scale,
+                         imageArea.y() / scale,
+                         imageArea.width() / scale,
+                         imageArea.height() / scale);
+
     bool drawObjects = mRenderFlags.testFlag(DrawObjects);
     bool drawTiles = mRenderFlags.testFlag(DrawTiles);
     bool drawImages = mRenderFlags.testFlag(DrawImages);
     bool drawTileGrid = mRenderFlags.testFlag(DrawGrid);
     bool visibleLayersOnly = mRenderFlags.testFlag(IgnoreInvisibleLayer);
 
-    // Remember the current render flags
+    // Remember the current render flags and level of detail threshold
     const Tiled::RenderFlags renderFlags = renderer->flags();
+    const qreal levelOfDetailThreshold = renderer->levelOfDetailThreshold();
     renderer->setFlag(ShowTileObjectOutlines, false);
 
-    mMapImage.fill(Qt::transparent);
+    // The renderer is shared with the map view, whose threshold would always
+    // apply at minimap scale. The minimap image is only rendered when the map
+    // changes, so it is rendered in full detail like exported images.
+    renderer->setLevelOfDetailThreshold(0);
+
     QPainter painter(&mMapImage);
+    painter.setClipRect(imageArea);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.fillRect(imageArea, Qt::transparent);
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+
     painter.setRenderHints(QPainter::SmoothPixmapTransform |
                            QPainter::HighQualityAntialiasing);
     painter.setTransform(QTransform::fromScale(scale, scale));
@@ -225,7 +405,7 @@ void MiniMap::renderMapToImage()
         const ImageLayer *imageLayer = dynamic_cast<const ImageLayer*>(layer);
 
         if (tileLayer && drawTiles) {
-            renderer->drawTileLayer(&painter, tileLayer);
+            renderer->drawTileLayer(&painter, tileLayer, exposed);
         } else if (objGroup && drawObjects) {
             QList<MapObject*> objects = objGroup->objects();
 
@@ -233,23 +413,24 @@ void MiniMap::renderMapToImage()
             qStableSort(objects.begin(), objects.end(), objectLessThan);
 
             foreach (const MapObject *object, objects) {
-                if (object->isVisible()) {
+                if (object->isVisible() &&
+                        objectRect(object).intersects(exposed)) {
                     const QColor color = MapObjectItem::objectColor(object);
                     renderer->drawMapObject(&painter, object, color);
                 }
             }
         } else if (imageLayer && drawImages) {
-            renderer->drawImageLayer(&painter, imageLayer);
+            renderer->drawImageLayer(&painter, imageLayer, exposed);
         }
     }
 
     if (drawTileGrid) {
         Preferences *prefs = Preferences::instance();
-        renderer->drawGrid(&painter, QRectF(QPointF(), renderer->mapSize()),
-                           prefs->gridColor());
+        renderer->drawGrid(&painter, exposed, prefs->gridColor());
     }
 
     renderer->setFlags(renderFlags);
+    renderer->setLevelOfDetailThreshold(levelOfDetailThreshold);
 }
 
 void MiniMap::centerViewOnLocalPixel(QPoint centerPos, int delta)
@@ -266,7 +447,12 @@ void MiniMap::centerViewOnLocalPixel(QPoint centerPos, int delta)
 
 void MiniMap::redrawTimeout()
 {
-    mRedrawMapImage = true;
+    if (mRedrawMapImage) {
+        resetMapImage();
+        mRedrawMapImage = false;
+    }
+
+    renderDirtyArea();
     update();
 }
 
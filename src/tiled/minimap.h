@@ -23,10 +23,15 @@
 #define MINIMAP_H
 
 #include <QFrame>
+#include <QHash>
 #include <QImage>
+#include <QRegion>
 #include <QTimer>
 
 namespace Tiled {
+
+class MapObject;
+
 namespace Internal {
 
 class MapDocument;
@@ -55,7 +60,7 @@ public:
     QSize sizeHint() const;
 
 public slots:
-    /** Schedules a redraw of the minimap image. */
+    /** Schedules a full redraw of the minimap image. */
     void scheduleMapImageUpdate();
 
 protected:
@@ -69,9 +74,17 @@ protected:
 private slots:
     void redrawTimeout();
 
+    void regionChanged(const QRegion &region);
+    void objectsAdded(const QList<MapObject*> &objects);
+    void objectsChanged(const QList<MapObject*> &objects);
+    void objectsRemoved(const QList<MapObject*> &objects);
+
 private:
     MapDocument *mMapDocument;
     QImage mMapImage;
+    qreal mMapImageScale;
+    QRegion mDirtyArea;
+    QHash<MapObject*, QRectF> mObjectRects;
     QRect mImageRect;
     QTimer mMapImageUpdateTimer;
     bool mDragging;
@@ -83,7 +96,11 @@ private:
     QRect viewportRect() const;
     QPointF mapToScene(QPoint p) const;
     void updateImageRect();
-    void renderMapToImage();
+    void resetMapImage();
+    void invalidateArea(const QRect &area);
+    QRectF objectRect(const MapObject *object) const;
+    void renderDirtyArea();
+    void renderArea(const QRect &area);
     void centerViewOnLocalPixel(QPoint centerPos, int delta = 0);
 };
 
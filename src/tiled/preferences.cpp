@@ -59,6 +59,9 @@ Preferences::Preferences()
     mLayerDataFormat = (Map::LayerDataFormat)
                        mSettings->value(QLatin1String("LayerDataFormat"),
                                         Map::Base64Zlib).toInt();
+    mCompressionLevel = (CompressionLevel)
+                        mSettings->value(QLatin1String("CompressionLevel"),
+                                         DefaultCompression).toInt();
     mDtdEnabled = boolValue("DtdEnabled");
     mReloadTilesetsOnChange = boolValue("ReloadTilesets", true);
     mSettings->endGroup();
@@ -73,8 +76,10 @@ Preferences::Preferences()
     mGridFine = intValue("GridFine", 4);
     mHighlightCurrentLayer = boolValue("HighlightCurrentLayer");
     mShowTilesetGrid = boolValue("ShowTilesetGrid", true);
+    mLowDetailZoom = intValue("LowDetailZoom", 20);
     mLanguage = stringValue("Language");
     mUseOpenGL = boolValue("OpenGL");
+    mCacheTileLayers = boolValue("CacheTileLayers");
     mSettings->endGroup();
 
     // Retrieve defined object types
@@ -188,6 +193,17 @@ void Preferences::setShowTilesetGrid(bool showTilesetGrid)
     emit showTilesetGridChanged(mShowTilesetGrid);
 }
 
+void Preferences::setLowDetailZoom(int lowDetailZoom)
+{
+    if (mLowDetailZoom == lowDetailZoom)
+        return;
+
+    mLowDetailZoom = lowDetailZoom;
+    mSettings->setValue(QLatin1String("Interface/LowDetailZoom"),
+                        mLowDetailZoom);
+    emit lowDetailZoomChanged(mLowDetailZoom);
+}
+
 Map::LayerDataFormat Preferences::layerDataFormat() const
 {
     return mLayerDataFormat;
@@ -204,6 +220,21 @@ void Preferences::setLayerDataFormat(Map::LayerDataFormat
                         mLayerDataFormat);
 }
 
+CompressionLevel Preferences::compressionLevel() const
+{
+    return mCompressionLevel;
+}
+
+void Preferences::setCompressionLevel(CompressionLevel compressionLevel)
+{
+    if (mCompressionLevel == compressionLevel)
+        return;
+
+    mCompressionLevel = compressionLevel;
+    mSettings->setValue(QLatin1String("Storage/CompressionLevel"),
+                        mCompressionLevel);
+}
+
 bool Preferences::dtdEnabled() const
 {
     return mDtdEnabled;
@@ -261,6 +292,18 @@ void Preferences::setUseOpenGL(bool useOpenGL)
     emit useOpenGLChanged(mUseOpenGL);
 }
 
+void Preferences::setCacheTileLayers(bool cacheTileLayers)
+{
+    if (mCacheTileLayers == cacheTileLayers)
+        return;
+
+    mCacheTileLayers = cacheTileLayers;
+    mSettings->setValue(QLatin1String("Interface/CacheTileLayers"),
+                        mCacheTileLayers);
+
+    emit cacheTileLayersChanged(mCacheTileLayers);
+}
+
 void Preferences::setObjectTypes(const ObjectTypes &objectTypes)
 {
     mObjectTypes = objectTypes;
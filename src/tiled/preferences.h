@@ -24,6 +24,7 @@
 #include <QObject>
 #include <QColor>
 
+#include "compression.h"
 #include "map.h"
 #include "objecttypes.h"
 
@@ -54,9 +55,18 @@ public:
     bool highlightCurrentLayer() const { return mHighlightCurrentLayer; }
     bool showTilesetGrid() const { return mShowTilesetGrid; }
 
+    /**
+     * The zoom level in percent below which tile layers are drawn at a low
+     * level of detail. 0 means they are always drawn in full detail.
+     */
+    int lowDetailZoom() const { return mLowDetailZoom; }
+
     Map::LayerDataFormat layerDataFormat() const;
     void setLayerDataFormat(Map::LayerDataFormat layerDataFormat);
 
+    CompressionLevel compressionLevel() const;
+    void setCompressionLevel(CompressionLevel compressionLevel);
+
     bool dtdEnabled() const;
     void setDtdEnabled(bool enabled);
 
@@ -69,6 +79,9 @@ public:
     bool useOpenGL() const { return mUseOpenGL; }
     void setUseOpenGL(bool useOpenGL);
 
+    bool cacheTileLayers() const { return mCacheTileLayers; }
+    void setCacheTileLayers(bool cacheTileLayers);
+
     const ObjectTypes &objectTypes() const { return mObjectTypes; }
     void setObjectTypes(const ObjectTypes &objectTypes);
 
@@ -102,6 +115,7 @@ public slots:
     void setGridFine(int gridFine);
     void setHighlightCurrentLayer(bool highlight);
     void setShowTilesetGrid(bool showTilesetGrid);
+    void setLowDetailZoom(int lowDetailZoom);
 
 signals:
     void showGridChanged(bool showGrid);
@@ -112,8 +126,10 @@ signals:
     void gridFineChanged(int gridFine);
     void highlightCurrentLayerChanged(bool highlight);
     void showTilesetGridChanged(bool showTilesetGrid);
+    void lowDetailZoomChanged(int lowDetailZoom);
 
     void useOpenGLChanged(bool useOpenGL);
+    void cacheTileLayersChanged(bool cacheTileLayers);
 
     void objectTypesChanged();
 
@@ -138,12 +154,15 @@ private:
     int mGridFine;
     bool mHighlightCurrentLayer;
     bool mShowTilesetGrid;
+    int mLowDetailZoom;
 
     Map::LayerDataFormat mLayerDataFormat;
+    CompressionLevel mCompressionLevel;
     bool mDtdEnabled;
     QString mLanguage;
     bool mReloadTilesetsOnChange;
     bool mUseOpenGL;
+    bool mCacheTileLayers;
     ObjectTypes mObjectTypes;
 
     bool mAutoMapDrawing;
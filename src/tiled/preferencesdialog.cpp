@@ -138,10 +138,14 @@ PreferencesDialog::PreferencesDialog(QWidget *parent) :
     connect(mUi->languageCombo, SIGNAL(currentIndexChanged(int)),
             SLOT(languageSelected(int)));
     connect(mUi->openGL, SIGNAL(toggled(bool)), SLOT(useOpenGLToggled(bool)));
+    connect(mUi->cacheTileLayers, SIGNAL(toggled(bool)),
+            SLOT(cacheTileLayersToggled(bool)));
     connect(mUi->gridColor, SIGNAL(colorChanged(QColor)),
             Preferences::instance(), SLOT(setGridColor(QColor)));
     connect(mUi->gridFine, SIGNAL(valueChanged(int)),
             Preferences::instance(), SLOT(setGridFine(int)));
+    connect(mUi->lowDetailZoom, SIGNAL(valueChanged(int)),
+            Preferences::instance(), SLOT(setLowDetailZoom(int)));
 
     connect(mUi->objectTypesTable->selectionModel(),
             SIGNAL(selectionChanged(QItemSelection,QItemSelection)),
@@ -178,8 +182,10 @@ void PreferencesDialog::changeEvent(QEvent *e)
     switch (e->type()) {
     case QEvent::LanguageChange: {
             const int formatIndex = mUi->layerDataCombo->currentIndex();
+            const int compressionIndex = mUi->compressionCombo->currentIndex();
             mUi->retranslateUi(this);
             mUi->layerDataCombo->setCurrentIndex(formatIndex);
+            mUi->compressionCombo->setCurrentIndex(compressionIndex);
             mUi->languageCombo->setItemText(0, tr("System default"));
         }
         break;
@@ -200,6 +206,11 @@ void PreferencesDialog::useOpenGLToggled(bool useOpenGL)
     Preferences::instance()->setUseOpenGL(useOpenGL);
 }
 
+void PreferencesDialog::cacheTileLayersToggled(bool cacheTileLayers)
+{
+    Preferences::instance()->setCacheTileLayers(cacheTileLayers);
+}
+
 void PreferencesDialog::addObjectType()
 {
     const int newRow = mObjectTypesModel->objectTypes().size();
@@ -300,6 +311,7 @@ void PreferencesDialog::fromPreferences()
     mUi->enableDtd->setChecked(prefs->dtdEnabled());
     if (mUi->openGL->isEnabled())
         mUi->openGL->setChecked(prefs->useOpenGL());
+    mUi->cacheTileLayers->setChecked(prefs->cacheTileLayers());
 
     int formatIndex = 0;
     switch (prefs->layerDataFormat()) {
@@ -321,6 +333,7 @@ void PreferencesDialog::fromPreferences()
         break;
     }
     mUi->layerDataCombo->setCurrentIndex(formatIndex);
+    mUi->compressionCombo->setCurrentIndex(prefs->compressionLevel());
 
     // Not found (-1) ends up at index 0, system default
     int languageIndex = mUi->languageCombo->findData(prefs->language());
@@ -329,6 +342,7 @@ void PreferencesDialog::fromPreferences()
     mUi->languageCombo->setCurrentIndex(languageIndex);
     mUi->gridColor->setColor(prefs->gridColor());
     mUi->gridFine->setValue(prefs->gridFine());
+    mUi->lowDetailZoom->setValue(prefs->lowDetailZoom());
     mUi->autoMapWhileDrawing->setChecked(prefs->automappingDrawing());
     mObjectTypesModel->setObjectTypes(prefs->objectTypes());
 }
@@ -340,6 +354,7 @@ void PreferencesDialog::toPreferences()
     prefs->setReloadTilesetsOnChanged(mUi->reloadTilesetImages->isChecked());
     prefs->setDtdEnabled(mUi->enableDtd->isChecked());
     prefs->setLayerDataFormat(layerDataFormat());
+    prefs->setCompressionLevel(compressionLevel());
     prefs->setAutomappingDrawing(mUi->autoMapWhileDrawing->isChecked());
 }
 
@@ -360,6 +375,19 @@ Map::LayerDataFormat PreferencesDialog::layerDataFormat() const
     }
 }
 
+CompressionLevel PreferencesDialog::compressionLevel() const
+{
+    switch (mUi->compressionCombo->currentIndex()) {
+    case 0:
+    default:
+        return DefaultCompression;
+    case 1:
+        return FastCompression;
+    case 2:
+        return BestCompression;
+    }
+}
+
 void PreferencesDialog::useAutomappingDrawingToggled(bool enabled)
 {
     Preferences::instance()->setAutomappingDrawing(enabled);
@@ -54,6 +54,7 @@ protected:
 private slots:
     void languageSelected(int index);
     void useOpenGLToggled(bool useOpenGL);
+    void cacheTileLayersToggled(bool cacheTileLayers);
     void useAutomappingDrawingToggled(bool enabled);
 
     void addObjectType();
@@ -69,6 +70,7 @@ private:
     void toPreferences();
 
     Map::LayerDataFormat layerDataFormat() const;
+    CompressionLevel compressionLevel() const;
 
     Ui::PreferencesDialog *mUi;
     QStringList mLanguages;
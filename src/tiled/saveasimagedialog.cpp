@@ -139,8 +139,10 @@ void SaveAsImageDialog::accept()
 
     // Remember the current render flags
     const Tiled::RenderFlags renderFlags = renderer->flags();
+    const qreal levelOfDetailThreshold = renderer->levelOfDetailThreshold();
 
     renderer->setFlag(ShowTileObjectOutlines, false);
+    renderer->setLevelOfDetailThreshold(0);
 
     QSize mapSize = renderer->mapSize();
     if (useCurrentScale)
@@ -194,6 +196,7 @@ void SaveAsImageDialog::accept()
 
     // Restore the previous render flags
     renderer->setFlags(renderFlags);
+    renderer->setLevelOfDetailThreshold(levelOfDetailThreshold);
 
     image.save(fileName);
     mPath = QFileInfo(fileName).path();
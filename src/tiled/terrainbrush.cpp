@@ -35,7 +35,6 @@
 
 #include <math.h>
 #include <QVector>
-#include <climits>
 
 using namespace Tiled;
 using namespace Tiled::Internal;
@@ -53,12 +52,19 @@ TerrainBrush::TerrainBrush(QObject *parent)
     , mBrushBehavior(Free)
     , mLineReferenceX(0)
     , mLineReferenceY(0)
+    , mScratchColumns(0)
+    , mScratchGeneration(0)
+    , mLastChunk(0)
+    , mLastChunkKey(-1)
+    , mQueueHead(0)
+    , mQueueCount(0)
 {
     setBrushMode(PaintTile);
 }
 
 TerrainBrush::~TerrainBrush()
 {
+    releaseScratch();
 }
 
 void TerrainBrush::activate(MapScene *scene)
@@ -185,6 +191,8 @@ void TerrainBrush::mapDocumentChanged(MapDocument *oldDocument,
 
     // Don't use setTerrain since we do not want to update the brush right now
     mTerrain = firstTerrain(newDocument);
+
+    releaseScratch();
 }
 
 void TerrainBrush::setTerrain(const Terrain *terrain)
@@ -215,10 +223,10 @@ void TerrainBrush::capture()
     // TODO: we need to know which corner the mouse is closest to...
 
     const Cell &cell = tileLayer->cellAt(tilePosition());
-    if (!cell.tile)
+    if (!cell.tile())
         return;
 
-    Terrain *t = cell.tile->terrainAtCorner(0);
+    Terrain *t = cell.tile()->terrainAtCorner(0);
     setTerrain(t);
 }
 
@@ -265,36 +273,8 @@ static Tile *findBestTile(Tileset *tileset, unsigned terrain, unsigned considera
     if (terrain == 0xFFFFFFFF)
         return NULL;
 
-    QList<Tile*> matches;
-    int penalty = INT_MAX;
-
-    // TODO: this is a slow linear search, perhaps we could use a better find algorithm...
-    int tileCount = tileset->tileCount();
-    for (int i = 0; i < tileCount; ++i) {
-        Tile *t = tileset->tileAt(i);
-        if ((t->terrain() & considerationMask) != (terrain & considerationMask))
-            continue;
-
-        // calculate the tile transition penalty based on shortest distance to target terrain type
-        int tr = tileset->terrainTransitionPenalty(t->terrain() >> 24, terrain >> 24);
-        int tl = tileset->terrainTransitionPenalty((t->terrain() >> 16) & 0xFF, (terrain >> 16) & 0xFF);
-        int br = tileset->terrainTransitionPenalty((t->terrain() >> 8) & 0xFF, (terrain >> 8) & 0xFF);
-        int bl = tileset->terrainTransitionPenalty(t->terrain() & 0xFF, terrain & 0xFF);
-
-        // if there is no path to the destination terrain, this isn't a useful transition
-        if (tr < 0 || tl < 0 || br < 0 || bl < 0)
-            continue;
-
-        // add tile to the candidate list
-        int transitionPenalty = tr + tl + br + bl;
-        if (transitionPenalty <= penalty) {
-            if (transitionPenalty < penalty)
-                matches.clear();
-            penalty = transitionPenalty;
-
-            matches.push_back(t);
-        }
-    }
+    const QList<Tile*> matches = tileset->bestTerrainMatches(terrain,
+                                                             considerationMask);
 
     // choose a candidate at random, with consideration for terrain probability
     if (!matches.isEmpty()) {
@@ -363,7 +343,6 @@ void TerrainBrush::updateBrush(QPoint cursorPos, const QVector<QPoint> *list)
 
     int layerWidth = currentLayer->width();
     int layerHeight = currentLayer->height();
-    int numTiles = layerWidth * layerHeight;
     int paintCorner = 0;
 
     // if we are in vertex paint mode, the bottom right corner on the map will appear as an invalid tile offset...
@@ -389,43 +368,41 @@ void TerrainBrush::updateBrush(QPoint cursorPos, const QVector<QPoint> *list)
         terrainId = mTerrain->id();
     }
 
-    // allocate a buffer to build the terrain tilemap (TODO: this could be retained per layer to save regular allocation)
-    Tile **newTerrain = new Tile*[numTiles];
+    // start a new generation of the retained working set, which marks all
+    // cells as unchecked and empties the consideration queue
+    resetScratch(layerWidth);
 
-    // allocate a buffer of flags for each tile that may be considered (TODO: this could be retained per layer to save regular allocation)
-    char *checked = new char[numTiles];
-    memset(checked, 0, numTiles);
-
-    // create a consideration list, and push the start points
-    QList<QPoint> transitionList;
+    // push the start points
     int initialTiles = 0;
 
     if (list) {
         // if we were supplied a list of start points
         foreach (const QPoint &p, *list) {
-            transitionList.append(p);
+            // points outside of the layer have no place in the working set
+            if (!currentLayer->contains(p))
+                continue;
+            enqueue(p);
             ++initialTiles;
         }
     } else {
-        transitionList.append(cursorPos);
+        enqueue(cursorPos);
         initialTiles = 1;
     }
 
     QRect brushRect(cursorPos, cursorPos);
 
     // produce terrain with transitions using a simple, relative naive approach (considers each tile once, and doesn't allow re-consideration if selection was bad)
-    while (!transitionList.isEmpty()) {
+    while (mQueueCount > 0) {
         // get the next point in the consideration list
-        QPoint p = transitionList.takeFirst();
+        QPoint p = dequeue();
         int x = p.x(), y = p.y();
-        int i = y*layerWidth + x;
 
         // if we have already considered this point, skip to the next
         // TODO: we might want to allow re-consideration if prior tiles... but not for now, this would risk infinite loops
-        if (checked[i])
+        if (isChecked(x, y))
             continue;
 
-        const Tile *tile = currentLayer->cellAt(p).tile;
+        const Tile *tile = currentLayer->cellAt(p).tile();
         const unsigned currentTerrain = ::terrain(tile);
 
         // get the tileset for this tile
@@ -472,20 +449,20 @@ void TerrainBrush::updateBrush(QPoint cursorPos, const QVector<QPoint> *list)
             mask = 0;
 
             // depending which connections have been set, we update the preferred terrain of the tile accordingly
-            if (y > 0 && checked[i - layerWidth]) {
-                preferredTerrain = (::terrain(newTerrain[i - layerWidth]) << 16) | (preferredTerrain & 0x0000FFFF);
+            if (y > 0 && isChecked(x, y - 1)) {
+                preferredTerrain = (::terrain(checkedTile(x, y - 1)) << 16) | (preferredTerrain & 0x0000FFFF);
                 mask |= 0xFFFF0000;
             }
-            if (y < layerHeight - 1 && checked[i + layerWidth]) {
-                preferredTerrain = (::terrain(newTerrain[i + layerWidth]) >> 16) | (preferredTerrain & 0xFFFF0000);
+            if (y < layerHeight - 1 && isChecked(x, y + 1)) {
+                preferredTerrain = (::terrain(checkedTile(x, y + 1)) >> 16) | (preferredTerrain & 0xFFFF0000);
                 mask |= 0x0000FFFF;
             }
-            if (x > 0 && checked[i - 1]) {
-                preferredTerrain = ((::terrain(newTerrain[i - 1]) << 8) & 0xFF00FF00) | (preferredTerrain & 0x00FF00FF);
+            if (x > 0 && isChecked(x - 1, y)) {
+                preferredTerrain = ((::terrain(checkedTile(x - 1, y)) << 8) & 0xFF00FF00) | (preferredTerrain & 0x00FF00FF);
                 mask |= 0xFF00FF00;
             }
-            if (x < layerWidth - 1 && checked[i + 1]) {
-                preferredTerrain = ((::terrain(newTerrain[i + 1]) >> 8) & 0x00FF00FF) | (preferredTerrain & 0xFF00FF00);
+            if (x < layerWidth - 1 && isChecked(x + 1, y)) {
+                preferredTerrain = ((::terrain(checkedTile(x + 1, y)) >> 8) & 0x00FF00FF) | (preferredTerrain & 0xFF00FF00);
                 mask |= 0x00FF00FF;
             }
         }
@@ -499,32 +476,31 @@ void TerrainBrush::updateBrush(QPoint cursorPos, const QVector<QPoint> *list)
         }
 
         // add tile to the brush
-        newTerrain[i] = paste;
-        checked[i] = true;
+        setChecked(x, y, paste);
 
         // expand the brush rect to fit the edit set
         brushRect |= QRect(p, p);
 
         // consider surrounding tiles if terrain constraints were not satisfied
-        if (y > 0 && !checked[i - layerWidth]) {
-            const Tile *above = currentLayer->cellAt(x, y - 1).tile;
+        if (y > 0 && !isChecked(x, y - 1)) {
+            const Tile *above = currentLayer->cellAt(x, y - 1).tile();
             if (topEdge(paste) != bottomEdge(above))
-                transitionList.append(QPoint(x, y - 1));
+                enqueue(QPoint(x, y - 1));
         }
-        if (y < layerHeight - 1 && !checked[i + layerWidth]) {
-            const Tile *below = currentLayer->cellAt(x, y + 1).tile;
+        if (y < layerHeight - 1 && !isChecked(x, y + 1)) {
+            const Tile *below = currentLayer->cellAt(x, y + 1).tile();
             if (bottomEdge(paste) != topEdge(below))
-                transitionList.append(QPoint(x, y + 1));
+                enqueue(QPoint(x, y + 1));
         }
-        if (x > 0 && !checked[i - 1]) {
-            const Tile *left = currentLayer->cellAt(x - 1, y).tile;
+        if (x > 0 && !isChecked(x - 1, y)) {
+            const Tile *left = currentLayer->cellAt(x - 1, y).tile();
             if (leftEdge(paste) != rightEdge(left))
-                transitionList.append(QPoint(x - 1, y));
+                enqueue(QPoint(x - 1, y));
         }
-        if (x < layerWidth - 1 && !checked[i + 1]) {
-            const Tile *right = currentLayer->cellAt(x + 1, y).tile;
+        if (x < layerWidth - 1 && !isChecked(x + 1, y)) {
+            const Tile *right = currentLayer->cellAt(x + 1, y).tile();
             if (rightEdge(paste) != leftEdge(right))
-                transitionList.append(QPoint(x + 1, y));
+                enqueue(QPoint(x + 1, y));
         }
     }
 
@@ -533,15 +509,14 @@ void TerrainBrush::updateBrush(QPoint cursorPos, const QVector<QPoint> *list)
 
     for (int y = brushRect.top(); y <= brushRect.bottom(); ++y) {
         for (int x = brushRect.left(); x <= brushRect.right(); ++x) {
-            int i = y*layerWidth + x;
-            if (!checked[i])
+            if (!isChecked(x, y))
                 continue;
 
-            Tile *tile = newTerrain[i];
+            Tile *tile = checkedTile(x, y);
             if (tile)
                 stamp->setCell(x - brushRect.left(), y - brushRect.top(), Cell(tile));
             else {
-                // TODO: we need to do something to erase tiles where checked[i] is true, and newTerrain[i] is NULL
+                // TODO: we need to do something to erase tiles that are checked, but have a NULL tile
                 // is there an eraser stamp? investigate how the eraser works...
             }
         }
@@ -550,9 +525,6 @@ void TerrainBrush::updateBrush(QPoint cursorPos, const QVector<QPoint> *list)
     // set the new tile layer as the brush
     brushItem()->setTileLayer(stamp);
 
-    delete[] checked;
-    delete[] newTerrain;
-
 /*
     const QPoint tilePos = tilePosition();
 
@@ -568,3 +540,114 @@ void TerrainBrush::updateBrush(QPoint cursorPos, const QVector<QPoint> *list)
     mOffsetX = cursorPos.x() - brushRect.left();
     mOffsetY = cursorPos.y() - brushRect.top();
 }
+
+// Upper bound on the number of retained scratch chunks (about 12 MB)
+static const int MaxScratchChunks = 256;
+
+void TerrainBrush::resetScratch(int layerWidth)
+{
+    const int columns = (layerWidth + ScratchChunk::Size - 1) /
+            ScratchChunk::Size;
+
+    // Drop the working set when the layer changed shape or when a large
+    // update left too many chunks behind
+    if (columns != mScratchColumns || mScratch.size() > MaxScratchChunks) {
+        releaseScratch();
+        mScratchColumns = columns;
+    }
+
+    if (++mScratchGeneration == 0) {
+        // The generation wrapped around, so stale marks could match again
+        foreach (ScratchChunk *chunk, mScratch)
+            memset(chunk->generation, 0, sizeof(chunk->generation));
+        mScratchGeneration = 1;
+    }
+
+    mQueueHead = 0;
+    mQueueCount = 0;
+}
+
+void TerrainBrush::releaseScratch()
+{
+    qDeleteAll(mScratch);
+    mScratch.clear();
+    mLastChunk = 0;
+    mLastChunkKey = -1;
+}
+
+TerrainBrush::ScratchChunk *TerrainBrush::scratchChunk(int x, int y,
+                                                       bool create)
+{
+    const int key = (y / ScratchChunk::Size) * mScratchColumns +
+            x / ScratchChunk::Size;
+
+    // Neighbouring cells are usually in the same chunk
+    if (key == mLastChunkKey)
+        return mLastChunk;
+
+    ScratchChunk *chunk = mScratch.value(key);
+    if (!chunk) {
+        if (!create)
+            return 0;
+
+        chunk = new ScratchChunk;
+        memset(chunk->generation, 0, sizeof(chunk->generation));
+        mScratch.insert(key, chunk);
+    }
+
+    mLastChunk = chunk;
+    mLastChunkKey = key;
+    return chunk;
+}
+
+static inline int scratchIndex(int x, int y, int size)
+{
+    return (y % size) * size + x % size;
+}
+
+bool TerrainBrush::isChecked(int x, int y)
+{
+    const ScratchChunk *chunk = scratchChunk(x, y, false);
+    return chunk && chunk->generation[scratchIndex(x, y, ScratchChunk::Size)]
+            == mScratchGeneration;
+}
+
+Tile *TerrainBrush::checkedTile(int x, int y)
+{
+    Q_ASSERT(isChecked(x, y));
+    const ScratchChunk *chunk = scratchChunk(x, y, false);
+    return chunk->tile[scratchIndex(x, y, ScratchChunk::Size)];
+}
+
+void TerrainBrush::setChecked(int x, int y, Tile *tile)
+{
+    ScratchChunk *chunk = scratchChunk(x, y, true);
+    const int index = scratchIndex(x, y, ScratchChunk::Size);
+    chunk->generation[index] = mScratchGeneration;
+    chunk->tile[index] = tile;
+}
+
+void TerrainBrush::enqueue(const QPoint &p)
+{
+    if (mQueueCount == mQueue.size()) {
+        // Grow the ring buffer, moving its contents to the front
+        const int oldSize = mQueue.size();
+        QVector<QPoint> queue(qMax(64, oldSize * 2));
+        for (int i = 0; i < mQueueCount; ++i)
+            queue[i] = mQueue.at((mQueueHead + i) % oldSize);
+        mQueue = queue;
+        mQueueHead = 0;
+    }
+
+    mQueue[(mQueueHead + mQueueCount) % mQueue.size()] = p;
+    ++mQueueCount;
+}
+
+QPoint TerrainBrush::dequeue()
+{
+    Q_ASSERT(mQueueCount > 0);
+    const QPoint p = mQueue.at(mQueueHead);
+    mQueueHead = (mQueueHead + 1) % mQueue.size();
+    --mQueueCount;
+    return p;
+}
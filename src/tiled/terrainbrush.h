@@ -26,6 +26,9 @@
 #include "abstracttiletool.h"
 #include "tilelayer.h"
 
+#include <QHash>
+#include <QVector>
+
 namespace Tiled {
 
 class Tile;
@@ -114,6 +117,27 @@ private:
      */
     void updateBrush(QPoint cursorPos, const QVector<QPoint> *list = NULL);
 
+    /**
+     * A square block of the working set used by updateBrush(). A cell has
+     * been checked during the current update when its generation matches
+     * mScratchGeneration, so the blocks never need to be cleared.
+     */
+    struct ScratchChunk {
+        enum { Size = 64 };
+        unsigned generation[Size * Size];
+        Tile *tile[Size * Size];
+    };
+
+    void resetScratch(int layerWidth);
+    void releaseScratch();
+    ScratchChunk *scratchChunk(int x, int y, bool create);
+    bool isChecked(int x, int y);
+    Tile *checkedTile(int x, int y);
+    void setChecked(int x, int y, Tile *tile);
+
+    void enqueue(const QPoint &p);
+    QPoint dequeue();
+
     /**
      * The terrain we are currently painting.
      */
@@ -148,6 +172,23 @@ private:
      * When drawing circles this will be the midpoint.
      */
     int mLineReferenceX, mLineReferenceY;
+
+    /**
+     * The working set of updateBrush(), retained between updates so that
+     * moving the brush doesn't allocate memory proportional to the layer.
+     */
+    QHash<int, ScratchChunk*> mScratch;
+    int mScratchColumns;
+    unsigned mScratchGeneration;
+    ScratchChunk *mLastChunk;
+    int mLastChunkKey;
+
+    /**
+     * Ring buffer holding the cells that still need to be considered.
+     */
+    QVector<QPoint> mQueue;
+    int mQueueHead;
+    int mQueueCount;
 };
 
 } // namespace Internal
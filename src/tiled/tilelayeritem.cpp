@@ -27,13 +27,40 @@
 
 #include <QPainter>
 #include <QStyleOptionGraphicsItem>
+#include <QtCore/qmath.h>
 
 using namespace Tiled;
 using namespace Tiled::Internal;
 
+namespace {
+
+/**
+ * The size of a cached chunk in tiles.
+ */
+const int ChunkSize = 16;
+
+/**
+ * The maximum amount of memory used by the cached chunks of one layer, in
+ * kilobytes. The least recently drawn chunks are discarded first.
+ */
+const int MaximumCacheCost = 32 * 1024;
+
+/**
+ * The number of chunks that should fit in the cache at any zoom level. This
+ * is more than a full screen view needs, so that painting doesn't keep
+ * evicting the chunks in view. Chunks too large for this are not cached,
+ * since at such zoom levels only a few tiles are visible anyway.
+ */
+const int MinimumCachedChunks = 32;
+
+} // anonymous namespace
+
 TileLayerItem::TileLayerItem(TileLayer *layer, MapRenderer *renderer)
     : mLayer(layer)
     , mRenderer(renderer)
+    , mCacheEnabled(false)
+    , mCacheScale(0)
+    , mChunks(MaximumCacheCost)
 {
     setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
 
@@ -45,6 +72,55 @@ void TileLayerItem::syncWithTileLayer()
 {
     prepareGeometryChange();
     mBoundingRect = mRenderer->boundingRect(mLayer->bounds());
+    invalidateCache();
+}
+
+void TileLayerItem::setCacheEnabled(bool enabled)
+{
+    if (mCacheEnabled == enabled)
+        return;
+
+    mCacheEnabled = enabled;
+    if (!mCacheEnabled)
+        invalidateCache();
+}
+
+void TileLayerItem::invalidateCache(const QRegion &region)
+{
+    if (mChunks.isEmpty())
+        return;
+
+    const QMargins margins = mLayer->drawMargins();
+    const QSizeF chunkSize = chunkRect(ChunkIndex(0, 0)).size();
+
+    foreach (const QRect &r, region.rects()) {
+        const QRectF rect = mRenderer->boundingRect(r).adjusted(-margins.left(),
+                                                                -margins.top(),
+                                                                margins.right(),
+                                                                margins.bottom());
+
+        const int startX = qFloor(rect.left() / chunkSize.width());
+        const int startY = qFloor(rect.top() / chunkSize.height());
+        const int endX = qCeil(rect.right() / chunkSize.width());
+        const int endY = qCeil(rect.bottom() / chunkSize.height());
+
+        // Large areas may cover many more chunks than are cached
+        if (qreal(endX - startX) * (endY - startY) > mChunks.size()) {
+            foreach (const ChunkIndex &index, mChunks.keys())
+                if (chunkRect(index).intersects(rect))
+                    mChunks.remove(index);
+            continue;
+        }
+
+        for (int y = startY; y < endY; ++y)
+            for (int x = startX; x < endX; ++x)
+                mChunks.remove(ChunkIndex(x, y));
+    }
+}
+
+void TileLayerItem::invalidateCache()
+{
+    mChunks.clear();
 }
 
 QRectF TileLayerItem::boundingRect() const
@@ -57,5 +133,94 @@ void TileLayerItem::paint(QPainter *painter,
                           QWidget *)
 {
     // TODO: Display a border around the layer when selected
+    if (mCacheEnabled) {
+        const qreal scale =
+                option->levelOfDetailFromTransform(painter->worldTransform());
+
+        if (drawCachedChunks(painter, option->exposedRect, scale))
+            return;
+    }
+
     mRenderer->drawTileLayer(painter, mLayer, option->exposedRect);
 }
+
+/**
+ * Returns the area covered by the chunk at \a index, in pixels.
+ */
+QRectF TileLayerItem::chunkRect(const ChunkIndex &index) const
+{
+    const Map *map = mLayer->map();
+    const qreal width = ChunkSize * map->tileWidth();
+    const qreal height = ChunkSize * map->tileHeight();
+
+    return QRectF(index.first * width, index.second * height, width, height);
+}
+
+/**
+ * Draws the chunks overlapping the \a exposed area, rendering those that are
+ * not cached yet at the given \a scale.
+ *
+ * Returns false when the chunks are too large to be cached at this scale, in
+ * which case nothing was drawn.
+ */
+bool TileLayerItem::drawCachedChunks(QPainter *painter,
+                                     const QRectF &exposed,
+                                     qreal scale)
+{
+    const QSizeF chunkSize = chunkRect(ChunkIndex(0, 0)).size();
+    const QSize pixmapSize(qCeil(chunkSize.width() * scale),
+                           qCeil(chunkSize.height() * scale));
+
+    if (pixmapSize.isEmpty())
+        return false;
+
+    // The cost of a chunk in kilobytes
+    const qreal cost = qreal(pixmapSize.width()) * pixmapSize.height()
+            * 4 / 1024;
+    if (cost > MaximumCacheCost / MinimumCachedChunks)
+        return false;
+
+    // Chunks are rendered for a specific zoom level
+    if (mCacheScale != scale) {
+        mChunks.clear();
+        mCacheScale = scale;
+    }
+
+    const QRectF rect = exposed.intersected(mBoundingRect);
+    if (rect.isEmpty())
+        return true;
+
+    const int startX = qFloor(rect.left() / chunkSize.width());
+    const int startY = qFloor(rect.top() / chunkSize.height());
+    const int endX = qCeil(rect.right() / chunkSize.width());
+    const int endY = qCeil(rect.bottom() / chunkSize.height());
+
+    for (int y = startY; y < endY; ++y) {
+        for (int x = startX; x < endX; ++x) {
+            const ChunkIndex index(x, y);
+            const QRectF area = chunkRect(index);
+            QPixmap *pixmap = mChunks.object(index);
+
+            if (!pixmap) {
+                pixmap = new QPixmap(pixmapSize);
+                pixmap->fill(Qt::transparent);
+
+                QPainter chunkPainter(pixmap);
+                chunkPainter.scale(scale, scale);
+                chunkPainter.translate(-area.topLeft());
+                mRenderer->drawTileLayer(&chunkPainter, mLayer, area);
+                chunkPainter.end();
+
+                // A single chunk always fits, so this never deletes it
+                mChunks.insert(index, pixmap, qCeil(cost));
+            }
+
+            painter->drawPixmap(QRectF(area.topLeft(),
+                                       QSizeF(pixmapSize) / scale),
+                                *pixmap,
+                                QRectF(pixmap->rect()));
+        }
+    }
+
+    return true;
+}
@@ -21,7 +21,11 @@
 #ifndef TILELAYERITEM_H
 #define TILELAYERITEM_H
 
+#include <QCache>
 #include <QGraphicsItem>
+#include <QPair>
+#include <QPixmap>
+#include <QRegion>
 
 namespace Tiled {
 
@@ -54,6 +58,26 @@ public:
      */
     void syncWithTileLayer();
 
+    /**
+     * Sets whether the layer is drawn from a cache of pre-rendered chunks.
+     * When enabled, each chunk is rendered only once for the current zoom
+     * level, so that scrolling over a static layer becomes a matter of
+     * drawing a few pixmaps.
+     */
+    void setCacheEnabled(bool enabled);
+    bool isCacheEnabled() const { return mCacheEnabled; }
+
+    /**
+     * Discards the cached chunks that overlap the given \a region, in tile
+     * coordinates. Should be called when the contents of the layer changed.
+     */
+    void invalidateCache(const QRegion &region);
+
+    /**
+     * Discards all cached chunks.
+     */
+    void invalidateCache();
+
     // QGraphicsItem
     QRectF boundingRect() const;
     void paint(QPainter *painter,
@@ -61,9 +85,19 @@ public:
                QWidget *widget = 0);
 
 private:
+    typedef QPair<int, int> ChunkIndex;
+
+    QRectF chunkRect(const ChunkIndex &index) const;
+    bool drawCachedChunks(QPainter *painter, const QRectF &exposed,
+                          qreal scale);
+
     TileLayer *mLayer;
     MapRenderer *mRenderer;
     QRectF mBoundingRect;
+
+    bool mCacheEnabled;
+    qreal mCacheScale;
+    QCache<ChunkIndex, QPixmap> mChunks;
 };
 
 } // namespace Internal
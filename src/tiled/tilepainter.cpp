@@ -58,7 +58,7 @@ void TilePainter::setCell(int x, int y, const Cell &cell)
         return;
 
     mTileLayer->setCell(layerX, layerY, cell);
-    mMapDocument->emitRegionChanged(QRegion(x, y, 1, 1));
+    mMapDocument->emitRegionChanged(QRegion(x, y, 1, 1), mTileLayer);
 }
 
 void TilePainter::setCells(int x, int y,
@@ -78,7 +78,7 @@ void TilePainter::setCells(int x, int y,
                          tileLayer,
                          region.translated(-mTileLayer->position()));
 
-    mMapDocument->emitRegionChanged(region);
+    mMapDocument->emitRegionChanged(region, mTileLayer);
 }
 
 void TilePainter::drawCells(int x, int y, TileLayer *tileLayer)
@@ -103,7 +103,7 @@ void TilePainter::drawCells(int x, int y, TileLayer *tileLayer)
         }
     }
 
-    mMapDocument->emitRegionChanged(region);
+    mMapDocument->emitRegionChanged(region, mTileLayer);
 }
 
 void TilePainter::drawStamp(const TileLayer *stamp,
@@ -137,7 +137,7 @@ void TilePainter::drawStamp(const TileLayer *stamp,
         }
     }
 
-    mMapDocument->emitRegionChanged(region);
+    mMapDocument->emitRegionChanged(region, mTileLayer);
 }
 
 void TilePainter::erase(const QRegion &region)
@@ -147,7 +147,7 @@ void TilePainter::erase(const QRegion &region)
         return;
 
     mTileLayer->erase(paintable.translated(-mTileLayer->position()));
-    mMapDocument->emitRegionChanged(paintable);
+    mMapDocument->emitRegionChanged(paintable, mTileLayer);
 }
 
 QRegion TilePainter::computeFillRegion(const QPoint &fillOrigin) const
@@ -218,21 +218,21 @@ void TileDelegate::paint(QPainter *painter,
     if (!tile)
         return;
 
-    const QPixmap &tileImage = tile->image();
+    const QSize tileSize = tile->size();
     const int extra = mTilesetView->drawGrid() ? 1 : 0;
     const qreal zoom = mTilesetView->scale();
 
     // Compute rectangle to draw the image in: bottom- and left-aligned
     QRect targetRect = option.rect.adjusted(0, 0, -extra, -extra);
-    targetRect.setTop(targetRect.bottom() - tileImage.height() * zoom + 1);
-    targetRect.setRight(targetRect.left() + tileImage.width() * zoom - 1);
+    targetRect.setTop(targetRect.bottom() - tileSize.height() * zoom + 1);
+    targetRect.setRight(targetRect.left() + tileSize.width() * zoom - 1);
 
     // Draw the tile image
     if (Zoomable *zoomable = mTilesetView->zoomable())
         if (zoomable->smoothTransform())
             painter->setRenderHint(QPainter::SmoothPixmapTransform);
 
-    painter->drawPixmap(targetRect, tileImage);
+    painter->drawPixmap(targetRect, tile->atlasImage(), tile->imageRect());
 
     // Overlay with highlight color when selected
     if (option.state & QStyle::State_Selected) {
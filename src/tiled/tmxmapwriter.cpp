@@ -39,6 +39,7 @@ bool TmxMapWriter::write(const Map *map, const QString &fileName)
 
     MapWriter writer;
     writer.setLayerDataFormat(format);
+    writer.setCompressionLevel(prefs->compressionLevel());
     writer.setDtdEnabled(prefs->dtdEnabled());
 
     bool result = writer.writeMap(map, fileName);
@@ -30,6 +30,9 @@
 
 #include <QApplication>
 #include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QRegExp>
 #include <QStringList>
 
 namespace {
@@ -41,15 +44,21 @@ struct CommandLineOptions {
         , scale(0.0)
         , tileSize(0)
         , useAntiAliasing(false)
+        , bandHeight(0)
+        , threadCount(0)
+        , pyramid(false)
     {}
 
     bool showHelp;
     bool showVersion;
-    QString fileToOpen;
-    QString fileToSave;
+    QStringList files;
+    QString batchDirectory;
     qreal scale;
     int tileSize;
     bool useAntiAliasing;
+    int bandHeight;
+    int threadCount;
+    bool pyramid;
 };
 
 } // anonymous namespace
@@ -60,6 +69,7 @@ static void showHelp()
     qWarning() <<
             "Usage:\n"
             "  tmxrasterizer [options] [input file] [output file]\n"
+            "  tmxrasterizer [options] --batch DIR [input files...]\n"
             "\n"
             "Options:\n"
             "  -h --help           : Display this help\n"
@@ -67,7 +77,16 @@ static void showHelp()
             "  -s --scale SCALE    : The scale of the output image\n"
             "  -t --tilesize SIZE  : The requested size in pixels at which a tile is rendered\n"
             "                        Overrides the --scale option\n"
-            "  -a --anti-aliasing  : Smooth the output image using anti-aliasing\n";
+            "  -a --anti-aliasing  : Smooth the output image using anti-aliasing\n"
+            "  -b --band-height N  : Render and write the image in bands of N rows, to\n"
+            "                        limit memory usage. Only PNG output is supported,\n"
+            "                        other output files are refused\n"
+            "  -j --threads COUNT  : The number of maps, bands or tiles rendered in parallel\n"
+            "                        (defaults to the number of processor cores)\n"
+            "  -p --pyramid        : Write a pyramid of 256x256 tiles for all zoom levels\n"
+            "                        to the output directory, as ZOOM/X/Y.png\n"
+            "  --batch DIR         : Render all input files to DIR, in parallel\n"
+            "                        Input files may contain wildcards\n";
 }
 
 static void showVersion()
@@ -116,20 +135,76 @@ static void parseCommandLineArguments(CommandLineOptions &options)
         } else if (arg == QLatin1String("--anti-aliasing")
                 || arg == QLatin1String("-a")) {
             options.useAntiAliasing = true;
+        } else if (arg == QLatin1String("--band-height")
+                || arg == QLatin1String("-b")) {
+            i++;
+            if (i >= arguments.size()) {
+                options.showHelp = true;
+            } else {
+                bool bandHeightIsInt;
+                options.bandHeight = arguments.at(i).toInt(&bandHeightIsInt);
+                if (!bandHeightIsInt || options.bandHeight <= 0) {
+                    qWarning() << arguments.at(i) << ": the specified band height is not a positive integer.";
+                    options.showHelp = true;
+                }
+            }
+        } else if (arg == QLatin1String("--batch")) {
+            i++;
+            if (i >= arguments.size())
+                options.showHelp = true;
+            else
+                options.batchDirectory = arguments.at(i);
+        } else if (arg == QLatin1String("--pyramid")
+                || arg == QLatin1String("-p")) {
+            options.pyramid = true;
+        } else if (arg == QLatin1String("--threads")
+                || arg == QLatin1String("-j")) {
+            i++;
+            if (i >= arguments.size()) {
+                options.showHelp = true;
+            } else {
+                bool threadCountIsInt;
+                options.threadCount = arguments.at(i).toInt(&threadCountIsInt);
+                if (!threadCountIsInt || options.threadCount <= 0) {
+                    qWarning() << arguments.at(i) << ": the specified thread count is not a positive integer.";
+                    options.showHelp = true;
+                }
+            }
         } else if (arg.isEmpty()) {
             options.showHelp = true;
         } else if (arg.at(0) == QLatin1Char('-')) {
             qWarning() << "Unknown option" << arg;
             options.showHelp = true;
-        } else if (options.fileToOpen.isEmpty()) {
-            options.fileToOpen = arg;
-        } else if (options.fileToSave.isEmpty()) {
-            options.fileToSave = arg;
         } else {
-            // All args are already defined. Show help.
-            options.showHelp = true;
+            options.files.append(arg);
+        }
+    }
+}
+
+/**
+ * Expands the wildcards in the file names of \a patterns, for shells that
+ * don't do this themselves.
+ */
+static QStringList expandWildcards(const QStringList &patterns)
+{
+    const QRegExp wildcards(QLatin1String("[*?\\[]"));
+    QStringList fileNames;
+
+    foreach (const QString &pattern, patterns) {
+        const QFileInfo fileInfo(pattern);
+        if (!fileInfo.fileName().contains(wildcards)) {
+            fileNames.append(pattern);
+            continue;
         }
+
+        const QDir dir = fileInfo.dir();
+        const QStringList entries = dir.entryList(QStringList(fileInfo.fileName()),
+                                                  QDir::Files, QDir::Name);
+        foreach (const QString &entry, entries)
+            fileNames.append(dir.filePath(entry));
     }
+
+    return fileNames;
 }
 
 int main(int argc, char *argv[])
@@ -147,7 +222,11 @@ int main(int argc, char *argv[])
         showVersion();
         return 0;
     }
-    if (options.showHelp || (options.fileToOpen.isEmpty() || options.fileToOpen.isEmpty())) {
+    const bool batch = !options.batchDirectory.isEmpty();
+    const QStringList files = batch ? expandWildcards(options.files)
+                                    : options.files;
+
+    if (options.showHelp || files.isEmpty() || (!batch && files.size() != 2)) {
         showHelp();
         return 0;
     }
@@ -158,6 +237,9 @@ int main(int argc, char *argv[])
 
     TmxRasterizer w;
     w.setAntiAliasing(options.useAntiAliasing);
+    w.setBandHeight(options.bandHeight);
+    if (options.threadCount > 0)
+        w.setThreadCount(options.threadCount);
 
     if (options.tileSize > 0) {
         w.setTileSize(options.tileSize);
@@ -165,6 +247,15 @@ int main(int argc, char *argv[])
         w.setScale(options.scale);
     }
 
-    w.render(options.fileToOpen, options.fileToSave);
+    if (batch) {
+        if (!w.renderBatch(files, options.batchDirectory, options.pyramid))
+            return 1;
+    } else if (options.pyramid) {
+        if (!w.renderPyramid(files.at(0), files.at(1)))
+            return 1;
+    } else if (!w.render(files.at(0), files.at(1))) {
+        return 1;
+    }
+
     return 0;
 }
@@ -0,0 +1,169 @@
+/*
+ * pngwriter.cpp
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of the TMX Rasterizer.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pngwriter.h"
+
+#include <QImage>
+#include <QtEndian>
+
+namespace {
+
+// The amount of compressed data collected before writing an IDAT chunk
+const int MaximumChunkSize = 256 * 1024;
+
+} // anonymous namespace
+
+PngWriter::PngWriter(const QString &fileName, const QSize &size)
+    : mFile(fileName)
+    , mSize(size)
+    , mRowsWritten(0)
+{
+}
+
+bool PngWriter::open()
+{
+    if (mSize.isEmpty()) {
+        mError = QLatin1String("Invalid image size");
+        return false;
+    }
+
+    if (!mDeflater.isValid()) {
+        mError = QLatin1String("Could not initialize compression");
+        return false;
+    }
+
+    if (!mFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        mError = mFile.errorString();
+        return false;
+    }
+
+    static const char signature[] = { '\x89', 'P', 'N', 'G',
+                                      '\r', '\n', '\x1a', '\n' };
+
+    if (mFile.write(signature, sizeof(signature)) != sizeof(signature)) {
+        mError = mFile.errorString();
+        return false;
+    }
+
+    QByteArray header(13, '\0');
+    uchar *data = reinterpret_cast<uchar*>(header.data());
+    qToBigEndian<quint32>(mSize.width(), data);
+    qToBigEndian<quint32>(mSize.height(), data + 4);
+    data[8] = 8;    // Bit depth
+    data[9] = 6;    // Color type: RGBA
+    data[10] = 0;   // Compression method: deflate
+    data[11] = 0;   // Filter method: adaptive
+    data[12] = 0;   // Interlace method: none
+
+    return writeChunk("IHDR", header);
+}
+
+bool PngWriter::writeRows(const QImage &image)
+{
+    if (image.width() != mSize.width() ||
+            mRowsWritten + image.height() > mSize.height()) {
+        mError = QLatin1String("Image rows don't match the image size");
+        return false;
+    }
+
+    const QImage source = image.format() == QImage::Format_ARGB32
+            ? image : image.convertToFormat(QImage::Format_ARGB32);
+
+    // Each row starts with its filter type, which is always 'None' here
+    const int width = mSize.width();
+    QByteArray row(1 + width * 4, '\0');
+
+    for (int y = 0; y < source.height(); ++y) {
+        const QRgb *pixels = reinterpret_cast<const QRgb*>(source.scanLine(y));
+        char *out = row.data() + 1;
+
+        for (int x = 0; x < width; ++x) {
+            const QRgb pixel = pixels[x];
+            *out++ = qRed(pixel);
+            *out++ = qGreen(pixel);
+            *out++ = qBlue(pixel);
+            *out++ = qAlpha(pixel);
+        }
+
+        mPendingData += mDeflater.deflate(row.constData(), row.size());
+
+        if (mPendingData.size() >= MaximumChunkSize && !writeImageData(false))
+            return false;
+    }
+
+    mRowsWritten += source.height();
+    return true;
+}
+
+bool PngWriter::close()
+{
+    if (mRowsWritten != mSize.height()) {
+        mError = QLatin1String("Not all image rows were written");
+        mFile.close();
+        return false;
+    }
+
+    const bool ok = writeImageData(true) && writeChunk("IEND", QByteArray());
+    mFile.close();
+    return ok;
+}
+
+bool PngWriter::writeImageData(bool finish)
+{
+    if (finish)
+        mPendingData += mDeflater.finish();
+
+    if (mPendingData.isEmpty())
+        return true;
+
+    const bool ok = writeChunk("IDAT", mPendingData);
+    mPendingData.clear();
+    return ok;
+}
+
+bool PngWriter::writeChunk(const char *type, const QByteArray &data)
+{
+    uchar length[4];
+    uchar crc[4];
+    qToBigEndian<quint32>(data.size(), length);
+
+    // The checksum covers the chunk type and data
+    quint32 checksum = Tiled::crc32(0, type, 4);
+    checksum = Tiled::crc32(checksum, data.constData(), data.size());
+    qToBigEndian<quint32>(checksum, crc);
+
+    if (mFile.write(reinterpret_cast<const char*>(length), 4) != 4 ||
+            mFile.write(type, 4) != 4 ||
+            mFile.write(data) != data.size() ||
+            mFile.write(reinterpret_cast<const char*>(crc), 4) != 4) {
+        mError = mFile.errorString();
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,83 @@
+/*
+ * pngwriter.h
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of the TMX Rasterizer.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PNGWRITER_H
+#define PNGWRITER_H
+
+#include "compression.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QSize>
+
+class QImage;
+
+/**
+ * Writes a PNG image row by row, so that the image never needs to be held in
+ * memory as a whole. Unlike QImageWriter, this allows writing images that
+ * are too large to allocate.
+ *
+ * The image is written with 8-bit RGBA pixels.
+ */
+class PngWriter
+{
+public:
+    PngWriter(const QString &fileName, const QSize &size);
+
+    /**
+     * Opens the file and writes the PNG header.
+     */
+    bool open();
+
+    /**
+     * Appends the rows of \a image to the PNG image. The image needs to have
+     * the width that was passed to the constructor.
+     */
+    bool writeRows(const QImage &image);
+
+    /**
+     * Writes the remaining data and closes the file. Fails when fewer rows
+     * were written than the height passed to the constructor.
+     */
+    bool close();
+
+    QString errorString() const { return mError; }
+
+private:
+    bool writeChunk(const char *type, const QByteArray &data);
+    bool writeImageData(bool finish);
+
+    QFile mFile;
+    QSize mSize;
+    int mRowsWritten;
+    Tiled::Deflater mDeflater;
+    QByteArray mPendingData;
+    QString mError;
+};
+
+#endif // PNGWRITER_H
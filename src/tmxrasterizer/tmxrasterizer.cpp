@@ -34,17 +34,259 @@
 #include "mapreader.h"
 #include "objectgroup.h"
 #include "orthogonalrenderer.h"
+#include "pngwriter.h"
 #include "staggeredrenderer.h"
 #include "tilelayer.h"
+#include "tileset.h"
 
+#include <QAtomicInt>
 #include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QTime>
+#include <QtCore/qmath.h>
 
 using namespace Tiled;
 
+namespace {
+
+// The size of the tiles written by TmxRasterizer::renderPyramid
+const int PyramidTileSize = 256;
+
+/**
+ * Returns the number of threads that can be used to render, given the
+ * \a requested number of threads.
+ */
+int usableThreadCount(int requested)
+{
+    // With Qt 4, pixmaps may only be drawn on the GUI thread
+#if QT_VERSION >= 0x050000
+    return qMax(1, requested);
+#else
+    Q_UNUSED(requested)
+    return 1;
+#endif
+}
+
+/**
+ * Renders the \a area of the output image, given in output pixels, using
+ * the exposed rect of the renderer to draw only what is needed.
+ */
+QImage renderArea(const Map *map, MapRenderer *renderer, const QRect &area,
+                  qreal xScale, qreal yScale, bool useAntiAliasing)
+{
+    QImage image(area.size(), QImage::Format_ARGB32);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+
+    if (xScale != qreal(1) || yScale != qreal(1)) {
+        if (useAntiAliasing) {
+            painter.setRenderHints(QPainter::SmoothPixmapTransform |
+                                   QPainter::Antialiasing);
+        }
+    }
+
+    painter.translate(-area.topLeft());
+    painter.scale(xScale, yScale);
+
+    const QRectF exposed(area.x() / xScale,
+                         area.y() / yScale,
+                         area.width() / xScale,
+                         area.height() / yScale);
+
+    // Perform a similar rendering than found in saveasimagedialog.cpp
+    foreach (Layer *layer, map->layers()) {
+        // Exclude all object groups and collision layers
+        if (layer->isObjectGroup() || layer->name().toLower() == "collision")
+            continue;
+
+        painter.setOpacity(layer->opacity());
+
+        const TileLayer *tileLayer = dynamic_cast<const TileLayer*>(layer);
+        const ImageLayer *imageLayer = dynamic_cast<const ImageLayer*>(layer);
+
+        if (tileLayer) {
+            renderer->drawTileLayer(&painter, tileLayer, exposed);
+        } else if (imageLayer) {
+            renderer->drawImageLayer(&painter, imageLayer, exposed);
+        }
+    }
+
+    return image;
+}
+
+/**
+ * Renders a horizontal band of the output image, so that several bands can
+ * be rendered in parallel on a QThreadPool.
+ */
+class BandRenderer : public QRunnable
+{
+public:
+    BandRenderer(const Map *map, MapRenderer *renderer, const QRect &band,
+                 qreal xScale, qreal yScale, bool useAntiAliasing)
+        : mMap(map)
+        , mRenderer(renderer)
+        , mBand(band)
+        , mXScale(xScale)
+        , mYScale(yScale)
+        , mUseAntiAliasing(useAntiAliasing)
+    {}
+
+    void run()
+    {
+        mImage = renderArea(mMap, mRenderer, mBand,
+                            mXScale, mYScale, mUseAntiAliasing);
+    }
+
+    const QImage &image() const { return mImage; }
+
+private:
+    const Map *mMap;
+    MapRenderer *mRenderer;
+    const QRect mBand;
+    const qreal mXScale;
+    const qreal mYScale;
+    const bool mUseAntiAliasing;
+    QImage mImage;
+};
+
+/**
+ * Returns whether all pixels of the \a image are fully transparent.
+ */
+bool isTransparent(const QImage &image)
+{
+    for (int y = 0; y < image.height(); ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x)
+            if (qAlpha(line[x]) != 0)
+                return false;
+    }
+    return true;
+}
+
+/**
+ * Renders a single tile of a map tile pyramid and saves it, unless it is
+ * empty.
+ */
+class PyramidTileRenderer : public QRunnable
+{
+public:
+    PyramidTileRenderer(const Map *map, MapRenderer *renderer,
+                        const QRect &tile, qreal xScale, qreal yScale,
+                        bool useAntiAliasing, const QString &fileName,
+                        QAtomicInt *failures)
+        : mMap(map)
+        , mRenderer(renderer)
+        , mTile(tile)
+        , mXScale(xScale)
+        , mYScale(yScale)
+        , mUseAntiAliasing(useAntiAliasing)
+        , mFileName(fileName)
+        , mFailures(failures)
+    {}
+
+    void run()
+    {
+        const QImage image = renderArea(mMap, mRenderer, mTile,
+                                        mXScale, mYScale, mUseAntiAliasing);
+        if (isTransparent(image))
+            return;
+
+        if (!image.save(mFileName)) {
+            qWarning() << "Error while writing" << mFileName;
+            mFailures->fetchAndAddRelaxed(1);
+        }
+    }
+
+private:
+    const Map *mMap;
+    MapRenderer *mRenderer;
+    const QRect mTile;
+    const qreal mXScale;
+    const qreal mYScale;
+    const bool mUseAntiAliasing;
+    const QString mFileName;
+    QAtomicInt *mFailures;
+};
+
+/**
+ * A map reader that reads images through the image cache of the rasterizer,
+ * so that maps sharing embedded tilesets don't read the same images again.
+ */
+class CachingMapReader : public MapReader
+{
+public:
+    explicit CachingMapReader(TmxRasterizer *rasterizer)
+        : mRasterizer(rasterizer)
+    {}
+
+protected:
+    QImage readExternalImage(const QString &source)
+    {
+        return mRasterizer->cachedImage(source);
+    }
+
+private:
+    TmxRasterizer *mRasterizer;
+};
+
+/**
+ * Renders one of the maps of a batch and reports the time it took.
+ */
+class BatchRenderer : public QRunnable
+{
+public:
+    BatchRenderer(TmxRasterizer *rasterizer, bool pyramid, int threadCount,
+                  const QString &mapFileName, const QString &outputFileName,
+                  QAtomicInt *failures)
+        : mRasterizer(rasterizer)
+        , mPyramid(pyramid)
+        , mThreadCount(threadCount)
+        , mMapFileName(mapFileName)
+        , mOutputFileName(outputFileName)
+        , mFailures(failures)
+    {}
+
+    void run()
+    {
+        QTime time;
+        time.start();
+
+        const bool success = mPyramid ?
+                    mRasterizer->renderPyramid(mMapFileName, mOutputFileName,
+                                               mThreadCount) :
+                    mRasterizer->render(mMapFileName, mOutputFileName,
+                                        mThreadCount);
+
+        if (success) {
+            qWarning().nospace() << qPrintable(mMapFileName) << ": "
+                                 << time.elapsed() << " ms";
+        } else {
+            mFailures->fetchAndAddRelaxed(1);
+        }
+    }
+
+private:
+    TmxRasterizer *mRasterizer;
+    const bool mPyramid;
+    const int mThreadCount;
+    const QString mMapFileName;
+    const QString mOutputFileName;
+    QAtomicInt *mFailures;
+};
+
+} // anonymous namespace
+
 TmxRasterizer::TmxRasterizer():
     mScale(1.0),
     mTileSize(0),
-    mUseAntiAliasing(true)
+    mUseAntiAliasing(true),
+    mBandHeight(0),
+    mThreadCount(QThread::idealThreadCount())
 {
 }
 
@@ -52,75 +294,364 @@ TmxRasterizer::~TmxRasterizer()
 {
 }
 
-void TmxRasterizer::render(const QString& mapFileName, const QString& bitmapFileName)
+QImage TmxRasterizer::cachedImage(const QString &fileName)
+{
+    QMutexLocker locker(&mImageCacheMutex);
+
+    QHash<QString, QImage>::const_iterator it = mImageCache.constFind(fileName);
+    if (it != mImageCache.constEnd())
+        return it.value();
+
+    // Images are read without holding the lock, so that the maps rendered in
+    // parallel don't wait for each other's images
+    locker.unlock();
+    const QImage image(fileName);
+    locker.relock();
+
+    // Share the copy of another thread that read the same image meanwhile
+    it = mImageCache.constFind(fileName);
+    if (it != mImageCache.constEnd())
+        return it.value();
+
+    mImageCache.insert(fileName, image);
+    return image;
+}
+
+Map *TmxRasterizer::readMap(const QString &mapFileName)
 {
-    Map *map;
-    MapRenderer *renderer;
-    MapReader reader;
-    map = reader.readMap(mapFileName);
-    if (!map) {
+    CachingMapReader reader(this);
+    reader.setTilesetCache(&mTilesetCache);
+    Map *map = reader.readMap(mapFileName);
+    if (!map)
         qWarning() << "Error while reading" << mapFileName << ":\n" << reader.errorString();
-        return;
-    }
+    return map;
+}
 
+/**
+ * Deletes the \a map along with its tilesets, except for those that are
+ * owned by the tileset cache.
+ */
+void TmxRasterizer::deleteMap(Map *map) const
+{
+    foreach (Tileset *tileset, map->tilesets())
+        if (!mTilesetCache.contains(tileset))
+            delete tileset;
+
+    delete map;
+}
+
+MapRenderer *TmxRasterizer::createRenderer(const Map *map) const
+{
     switch (map->orientation()) {
     case Map::Isometric:
-        renderer = new IsometricRenderer(map);
-        break;
+        return new IsometricRenderer(map);
     case Map::Staggered:
-        renderer = new StaggeredRenderer(map);
+        return new StaggeredRenderer(map);
     case Map::Orthogonal:
     default:
-        renderer = new OrthogonalRenderer(map);
-        break;
+        return new OrthogonalRenderer(map);
     }
+}
 
-    qreal xScale, yScale;
-
+void TmxRasterizer::determineScale(const Map *map,
+                                   qreal &xScale, qreal &yScale) const
+{
     if (mTileSize > 0) {
         xScale = (qreal) mTileSize/map->tileWidth();
         yScale = (qreal) mTileSize/map->tileHeight();
     } else {
         xScale = yScale = mScale;
     }
+}
+
+bool TmxRasterizer::render(const QString& mapFileName, const QString& bitmapFileName)
+{
+    return render(mapFileName, bitmapFileName, mThreadCount);
+}
+
+bool TmxRasterizer::render(const QString &mapFileName,
+                           const QString &bitmapFileName,
+                           int threadCount)
+{
+    // Bands are streamed by the PngWriter, which can't write other formats
+    if (mBandHeight > 0 && QFileInfo(bitmapFileName).suffix().compare(
+                QLatin1String("png"), Qt::CaseInsensitive) != 0) {
+        qWarning() << "Error while writing" << bitmapFileName << ":\n"
+                   << "Rendering in bands only supports PNG output";
+        return false;
+    }
+
+    Map *map = readMap(mapFileName);
+    if (!map)
+        return false;
+
+    MapRenderer *renderer = createRenderer(map);
+
+    qreal xScale, yScale;
+    determineScale(map, xScale, yScale);
 
     QSize mapSize = renderer->mapSize();
     mapSize.rwidth() *= xScale;
     mapSize.rheight() *= yScale;
 
-    QImage image(mapSize, QImage::Format_ARGB32);
-    image.fill(Qt::transparent);
-    QPainter painter(&image);
+    bool success;
 
-    if (xScale != qreal(1) || yScale != qreal(1)) {
-        if (mUseAntiAliasing) {
-            painter.setRenderHints(QPainter::SmoothPixmapTransform |
-                                   QPainter::Antialiasing);
+    if (mBandHeight > 0) {
+        success = renderBands(map, renderer, mapSize, xScale, yScale,
+                              bitmapFileName, threadCount);
+    } else {
+        const QImage image = renderArea(map, renderer,
+                                        QRect(QPoint(), mapSize),
+                                        xScale, yScale, mUseAntiAliasing);
+
+        // Save image
+        success = image.save(bitmapFileName);
+        if (!success)
+            qWarning() << "Error while writing" << bitmapFileName;
+    }
+
+    delete renderer;
+    deleteMap(map);
+
+    return success;
+}
+
+/**
+ * Renders the map in bands of mBandHeight rows and streams them to a PNG
+ * file. Up to \a threadCount bands are rendered in parallel, and only those
+ * are held in memory.
+ */
+bool TmxRasterizer::renderBands(const Map *map, MapRenderer *renderer,
+                                const QSize &imageSize,
+                                qreal xScale, qreal yScale,
+                                const QString &bitmapFileName,
+                                int threadCount)
+{
+    PngWriter writer(bitmapFileName, imageSize);
+    if (!writer.open()) {
+        qWarning() << "Error while writing" << bitmapFileName << ":\n"
+                   << writer.errorString();
+        return false;
+    }
+
+    const int batchSize = usableThreadCount(threadCount);
+
+    QThreadPool threadPool;
+    threadPool.setMaxThreadCount(batchSize);
+
+    bool success = true;
+    int top = 0;
+
+    while (success && top < imageSize.height()) {
+        QList<BandRenderer*> bands;
+
+        for (int i = 0; i < batchSize && top < imageSize.height(); ++i) {
+            const int height = qMin(mBandHeight, imageSize.height() - top);
+            const QRect band(0, top, imageSize.width(), height);
+
+            bands.append(new BandRenderer(map, renderer, band,
+                                          xScale, yScale, mUseAntiAliasing));
+            top += height;
+        }
+
+        if (batchSize > 1) {
+            foreach (BandRenderer *band, bands) {
+                band->setAutoDelete(false);
+                threadPool.start(band);
+            }
+            threadPool.waitForDone();
+        } else {
+            foreach (BandRenderer *band, bands)
+                band->run();
         }
-        painter.setTransform(QTransform::fromScale(xScale, yScale));
+
+        // Bands are written in order, as soon as the whole batch is done
+        foreach (BandRenderer *band, bands)
+            if (success)
+                success = writer.writeRows(band->image());
+
+        qDeleteAll(bands);
     }
-    // Perform a similar rendering than found in saveasimagedialog.cpp
-    foreach (Layer *layer, map->layers()) {
-        // Exclude all object groups and collision layers
-        if (layer->isObjectGroup() || layer->name().toLower() == "collision")
-            continue;
 
-        painter.setOpacity(layer->opacity());
+    if (success)
+        success = writer.close();
 
-        const TileLayer *tileLayer = dynamic_cast<const TileLayer*>(layer);
-        const ImageLayer *imageLayer = dynamic_cast<const ImageLayer*>(layer);
+    if (!success) {
+        qWarning() << "Error while writing" << bitmapFileName << ":\n"
+                   << writer.errorString();
+    }
 
-        if (tileLayer) {
-            renderer->drawTileLayer(&painter, tileLayer);
-        } else if (imageLayer) {
-            renderer->drawImageLayer(&painter, imageLayer);
+    return success;
+}
+
+/**
+ * Renders the map as a pyramid of tiles for use in zoomable web maps. The
+ * tiles are written to \a directory as z/x/y.png, where zoom level 0 fits
+ * the whole map in a single tile and the highest zoom level renders the map
+ * at the configured scale. Empty tiles are skipped.
+ */
+bool TmxRasterizer::renderPyramid(const QString &mapFileName,
+                                  const QString &directory)
+{
+    return renderPyramid(mapFileName, directory, mThreadCount);
+}
+
+bool TmxRasterizer::renderPyramid(const QString &mapFileName,
+                                  const QString &directory,
+                                  int threadCount)
+{
+    Map *map = readMap(mapFileName);
+    if (!map)
+        return false;
+
+    MapRenderer *renderer = createRenderer(map);
+
+    qreal xScale, yScale;
+    determineScale(map, xScale, yScale);
+
+    const QSize mapSize = renderer->mapSize();
+    const qreal largestSide = qMax(mapSize.width() * xScale,
+                                   mapSize.height() * yScale);
+
+    int maxZoom = 0;
+    while ((PyramidTileSize << maxZoom) < largestSide)
+        ++maxZoom;
+
+    const int usableThreads = usableThreadCount(threadCount);
+    const bool parallel = usableThreads > 1;
+
+    QThreadPool threadPool;
+    threadPool.setMaxThreadCount(usableThreads);
+
+    QAtomicInt failures;
+    const QDir dir(directory);
+
+    for (int zoom = 0; zoom <= maxZoom; ++zoom) {
+        const qreal factor = qreal(1) / (1 << (maxZoom - zoom));
+        const qreal zoomXScale = xScale * factor;
+        const qreal zoomYScale = yScale * factor;
+
+        const int columns = qCeil(mapSize.width() * zoomXScale / PyramidTileSize);
+        const int rows = qCeil(mapSize.height() * zoomYScale / PyramidTileSize);
+
+        for (int x = 0; x < columns; ++x) {
+            const QString column = QString::number(zoom) + QLatin1Char('/') +
+                    QString::number(x);
+
+            if (!dir.mkpath(column)) {
+                qWarning() << "Error while creating" << dir.filePath(column);
+                failures.fetchAndAddRelaxed(1);
+                continue;
+            }
+
+            for (int y = 0; y < rows; ++y) {
+                const QRect tile(x * PyramidTileSize, y * PyramidTileSize,
+                                 PyramidTileSize, PyramidTileSize);
+                const QString fileName = dir.filePath(column + QLatin1Char('/') +
+                                                      QString::number(y) +
+                                                      QLatin1String(".png"));
+
+                PyramidTileRenderer *tileRenderer =
+                        new PyramidTileRenderer(map, renderer, tile,
+                                                zoomXScale, zoomYScale,
+                                                mUseAntiAliasing, fileName,
+                                                &failures);
+                if (parallel) {
+                    threadPool.start(tileRenderer);
+                } else {
+                    tileRenderer->run();
+                    delete tileRenderer;
+                }
+            }
         }
     }
 
-    // Save image
-    image.save(bitmapFileName);
+    threadPool.waitForDone();
 
     delete renderer;
-    qDeleteAll(map->tilesets());
-    delete map;
+    deleteMap(map);
+
+    return failures.fetchAndAddRelaxed(0) == 0;
+}
+
+/**
+ * Renders all maps in \a mapFileNames to \a directory, naming the output
+ * files after the maps. The maps are rendered in parallel, sharing the
+ * tilesets and images they have in common, and the time taken to render
+ * each map is reported.
+ *
+ * In pyramid mode, a directory named after each map is used for its tiles.
+ * Nothing is rendered when two maps would be rendered to the same output.
+ */
+bool TmxRasterizer::renderBatch(const QStringList &mapFileNames,
+                                const QString &directory,
+                                bool pyramid)
+{
+    const QDir dir(directory);
+    if (!dir.mkpath(QLatin1String("."))) {
+        qWarning() << "Error while creating" << directory;
+        return false;
+    }
+
+    const int usableThreads = usableThreadCount(mThreadCount);
+    const bool parallel = usableThreads > 1;
+
+    QThreadPool threadPool;
+    threadPool.setMaxThreadCount(usableThreads);
+
+    // Each map is rendered by a single thread when the maps are rendered in
+    // parallel, to avoid starting a thread pool for each of them
+    const int mapThreadCount = parallel ? 1 : mThreadCount;
+
+    // Maps with the same name in different directories would overwrite
+    // each other's output, so they are refused before rendering anything
+    QHash<QString, QString> mapFileNamesByOutput;
+    QStringList outputFileNames;
+
+    foreach (const QString &mapFileName, mapFileNames) {
+        QString outputFileName = QFileInfo(mapFileName).completeBaseName();
+        if (!pyramid)
+            outputFileName += QLatin1String(".png");
+        outputFileName = dir.filePath(outputFileName);
+
+        const QString other = mapFileNamesByOutput.value(outputFileName);
+        if (!other.isEmpty()) {
+            qWarning() << "Error:" << other << "and" << mapFileName
+                       << "would both be rendered to" << outputFileName;
+            return false;
+        }
+
+        mapFileNamesByOutput.insert(outputFileName, mapFileName);
+        outputFileNames.append(outputFileName);
+    }
+
+    QAtomicInt failures;
+    QTime time;
+    time.start();
+
+    for (int i = 0; i < mapFileNames.size(); ++i) {
+        const QString &mapFileName = mapFileNames.at(i);
+        const QString &outputFileName = outputFileNames.at(i);
+
+        BatchRenderer *batchRenderer = new BatchRenderer(this, pyramid,
+                                                         mapThreadCount,
+                                                         mapFileName,
+                                                         outputFileName,
+                                                         &failures);
+        if (parallel) {
+            threadPool.start(batchRenderer);
+        } else {
+            batchRenderer->run();
+            delete batchRenderer;
+        }
+    }
+
+    threadPool.waitForDone();
+
+    const int failed = failures.fetchAndAddRelaxed(0);
+    qWarning().nospace() << "Rendered " << mapFileNames.size() - failed
+                         << " of " << mapFileNames.size() << " maps in "
+                         << time.elapsed() << " ms";
+
+    return failed == 0;
 }
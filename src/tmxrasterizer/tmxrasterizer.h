@@ -29,8 +29,21 @@
 #ifndef TMXRASTERIZER_H
 #define TMXRASTERIZER_H
 
+#include "tilesetcache.h"
+
+#include <QHash>
+#include <QImage>
+#include <QMutex>
 #include <QString>
 
+class QSize;
+class QStringList;
+
+namespace Tiled {
+class Map;
+class MapRenderer;
+}
+
 class TmxRasterizer
 {
 
@@ -41,17 +54,70 @@ public:
     qreal scale() const { return mScale; }
     int tileSize() const { return mTileSize; }
     bool useAntiAliasing() const { return mUseAntiAliasing; }
+    int bandHeight() const { return mBandHeight; }
+    int threadCount() const { return mThreadCount; }
 
     void setScale(qreal scale) { mScale = scale; }
     void setTileSize(int tileSize) { mTileSize = tileSize; }
     void setAntiAliasing(bool useAntiAliasing) { mUseAntiAliasing = useAntiAliasing; }
 
-    void render(const QString &mapFileName, const QString &bitmapFileName);
+    /**
+     * Sets the height in pixels of the bands in which the image is rendered
+     * and written. When larger than 0, only a few bands are held in memory at
+     * any time, which allows rendering images that are too large to
+     * allocate. This only supports writing PNG images.
+     */
+    void setBandHeight(int bandHeight) { mBandHeight = bandHeight; }
+
+    /**
+     * Sets the number of bands that are rendered in parallel.
+     */
+    void setThreadCount(int threadCount) { mThreadCount = threadCount; }
+
+    bool render(const QString &mapFileName, const QString &bitmapFileName);
+    bool renderPyramid(const QString &mapFileName, const QString &directory);
+
+    /**
+     * Renders the map using at most \a threadCount threads, instead of
+     * threadCount(). Used by renderBatch() to render the bands or tiles of
+     * each map serially while the maps themselves are rendered in parallel.
+     */
+    bool render(const QString &mapFileName, const QString &bitmapFileName,
+                int threadCount);
+    bool renderPyramid(const QString &mapFileName, const QString &directory,
+                       int threadCount);
+
+    bool renderBatch(const QStringList &mapFileNames,
+                     const QString &directory,
+                     bool pyramid = false);
+
+    /**
+     * Returns the image stored in \a fileName. Each image is cached after
+     * being read, so that maps rendered by the same rasterizer can share their
+     * images. Only maps loaded at the same time may read an image twice.
+     */
+    QImage cachedImage(const QString &fileName);
 
 private:
+    Tiled::Map *readMap(const QString &mapFileName);
+    void deleteMap(Tiled::Map *map) const;
+    Tiled::MapRenderer *createRenderer(const Tiled::Map *map) const;
+    void determineScale(const Tiled::Map *map,
+                        qreal &xScale, qreal &yScale) const;
+
+    bool renderBands(const Tiled::Map *map, Tiled::MapRenderer *renderer,
+                     const QSize &imageSize, qreal xScale, qreal yScale,
+                     const QString &bitmapFileName, int threadCount);
+
     qreal mScale;
     int mTileSize;
     bool mUseAntiAliasing;
+    int mBandHeight;
+    int mThreadCount;
+
+    Tiled::TilesetCache mTilesetCache;
+    QMutex mImageCacheMutex;
+    QHash<QString, QImage> mImageCache;
 };
 
 #endif // TMXRASTERIZER_H
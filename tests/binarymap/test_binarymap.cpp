@@ -0,0 +1,459 @@
+#include "binarymapreader.h"
+#include "binarymapwriter.h"
+#include "imagelayer.h"
+#include "map.h"
+#include "mapobject.h"
+#include "mapwriter.h"
+#include "objectgroup.h"
+#include "tile.h"
+#include "tilelayer.h"
+#include "tileset.h"
+#include "tilesetcache.h"
+
+#include <QtEndian>
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+
+class test_BinaryMap : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void roundTrip();
+    void externalTilesetCache();
+
+    void truncatedMap();
+    void corruptMap_data();
+    void corruptMap();
+
+private:
+    Map *createMap();
+
+    QString mImageFileName;
+    QString mTilesetFileName;
+    QString mMapFileName;
+    Tileset *mExternalTileset;
+};
+
+/**
+ * Deletes the \a map along with its tilesets, except for those that are
+ * owned by the given \a cache.
+ */
+static void deleteMap(Map *map, const TilesetCache *cache = 0)
+{
+    foreach (Tileset *tileset, map->tilesets())
+        if (!cache || !cache->contains(tileset))
+            delete tileset;
+    delete map;
+}
+
+static void appendUInt(QByteArray &data, quint32 value)
+{
+    uchar bytes[4];
+    qToLittleEndian(value, bytes);
+    data.append(reinterpret_cast<const char*>(bytes), 4);
+}
+
+/**
+ * Returns the header of a 4x4 binary map with the given \a orientation and
+ * \a layerDataFormat, followed by \a stringCount single letter strings. The
+ * tilesets and layers are left to be appended.
+ */
+static QByteArray mapHeader(quint32 orientation = Map::Orthogonal,
+                            quint32 layerDataFormat = Map::Base64Zlib,
+                            quint32 stringCount = 0)
+{
+    QByteArray data;
+    appendUInt(data, 0x31424D54);      // Magic
+    appendUInt(data, 1);               // Version
+    appendUInt(data, stringCount);
+    for (quint32 i = 0; i < stringCount; ++i) {
+        appendUInt(data, 1);
+        data.append('a' + char(i));
+    }
+    appendUInt(data, orientation);
+    appendUInt(data, 4);               // Width
+    appendUInt(data, 4);               // Height
+    appendUInt(data, 16);              // Tile width
+    appendUInt(data, 16);              // Tile height
+    appendUInt(data, 0);               // Background color (invalid)
+    appendUInt(data, 0);
+    appendUInt(data, layerDataFormat);
+    appendUInt(data, 0);               // Properties
+    return data;
+}
+
+/**
+ * Appends the attributes of a 4x4 layer of the given \a kind, named by the
+ * first string.
+ */
+static void appendLayer(QByteArray &data, quint32 kind)
+{
+    appendUInt(data, kind);
+    appendUInt(data, 0);               // Name
+    appendUInt(data, 0);               // X
+    appendUInt(data, 0);               // Y
+    appendUInt(data, 4);               // Width
+    appendUInt(data, 4);               // Height
+    data.append(QByteArray(8, '\0'));  // Opacity
+    appendUInt(data, 1);               // Visible
+    appendUInt(data, 0);               // Properties
+}
+
+static QByteArray tileLayerWithChunk(int x, int y, int width, int height,
+                                     const QByteArray &chunk)
+{
+    QByteArray data = mapHeader(Map::Orthogonal, Map::Base64Zlib, 1);
+    appendUInt(data, 0);               // Tilesets
+    appendUInt(data, 1);               // Layers
+    appendLayer(data, 0);
+    appendUInt(data, 1);               // Chunks
+    appendUInt(data, x);
+    appendUInt(data, y);
+    appendUInt(data, width);
+    appendUInt(data, height);
+    appendUInt(data, chunk.size());
+    data.append(chunk);
+    return data;
+}
+
+static void compareCells(const Cell &actual, const Cell &expected)
+{
+    QCOMPARE(actual.isEmpty(), expected.isEmpty());
+    QCOMPARE(actual.flipFlags(), expected.flipFlags());
+    if (!expected.isEmpty()) {
+        QCOMPARE(actual.tile()->id(), expected.tile()->id());
+        QCOMPARE(actual.tile()->tileset()->name(),
+                 expected.tile()->tileset()->name());
+    }
+}
+
+void test_BinaryMap::initTestCase()
+{
+    const QString tempPath = QDir::tempPath();
+    mImageFileName = tempPath + QLatin1String("/test_binarymap_tiles.png");
+    mTilesetFileName = tempPath + QLatin1String("/test_binarymap.tsx");
+    mMapFileName = tempPath + QLatin1String("/test_binarymap.tmb");
+
+    // A tileset image with four 16x16 tiles
+    QImage image(32, 32, QImage::Format_ARGB32);
+    image.fill(0);
+    QVERIFY(image.save(mImageFileName));
+
+    mExternalTileset = new Tileset(QLatin1String("external"), 16, 16);
+    QVERIFY(mExternalTileset->loadFromImage(QImage(mImageFileName),
+                                            mImageFileName));
+
+    MapWriter writer;
+    QVERIFY(writer.writeTileset(mExternalTileset, mTilesetFileName));
+    mExternalTileset->setFileName(mTilesetFileName);
+}
+
+void test_BinaryMap::cleanupTestCase()
+{
+    delete mExternalTileset;
+
+    QFile::remove(mImageFileName);
+    QFile::remove(mTilesetFileName);
+    QFile::remove(mMapFileName);
+}
+
+/**
+ * Creates a map using all features of the format. The external tileset is
+ * shared, so it should not be deleted along with the map.
+ */
+Map *test_BinaryMap::createMap()
+{
+    Map *map = new Map(Map::Isometric, 70, 66, 32, 16);
+    map->setBackgroundColor(QColor(10, 20, 30));
+    map->setLayerDataFormat(Map::CSV);
+    map->setProperty(QLatin1String("name"), QLatin1String("value"));
+
+    Tileset *embedded = new Tileset(QLatin1String("embedded"), 16, 16);
+    embedded->loadFromImage(QImage(mImageFileName), mImageFileName);
+    map->addTileset(embedded);
+    map->addTileset(mExternalTileset);
+
+    // Large enough to span several chunks, of which some stay empty
+    TileLayer *tileLayer = new TileLayer(QLatin1String("Tiles"), 0, 0, 70, 66);
+    tileLayer->setOpacity(0.5);
+    tileLayer->setProperty(QLatin1String("layer"), QLatin1String("tiles"));
+
+    Cell flipped(mExternalTileset->tileAt(3));
+    flipped.setFlippedHorizontally(true);
+    flipped.setFlippedVertically(true);
+    flipped.setFlippedAntiDiagonally(true);
+
+    tileLayer->setCell(0, 0, Cell(embedded->tileAt(1)));
+    tileLayer->setCell(63, 63, flipped);
+    tileLayer->setCell(64, 65, Cell(mExternalTileset->tileAt(0)));
+    tileLayer->setCell(69, 0, Cell(embedded->tileAt(3)));
+    map->addLayer(tileLayer);
+
+    ObjectGroup *objectGroup = new ObjectGroup(QLatin1String("Objects"),
+                                               0, 0, 70, 66);
+    objectGroup->setColor(QColor(255, 0, 0));
+    objectGroup->setVisible(false);
+
+    MapObject *tileObject = new MapObject(QLatin1String("tile"),
+                                          QLatin1String("type"),
+                                          QPointF(1.5, 2.25), QSizeF(1, 1));
+    tileObject->setCell(flipped);
+    tileObject->setRotation(45);
+    tileObject->setProperty(QLatin1String("object"), QLatin1String("tile"));
+    objectGroup->addObject(tileObject);
+
+    MapObject *polygon = new MapObject(QLatin1String("polygon"), QString(),
+                                       QPointF(3, 4), QSizeF());
+    polygon->setShape(MapObject::Polygon);
+    polygon->setPolygon(QPolygonF() << QPointF(0, 0) << QPointF(2, 0)
+                        << QPointF(1, 1.5));
+    objectGroup->addObject(polygon);
+    map->addLayer(objectGroup);
+
+    ImageLayer *imageLayer = new ImageLayer(QLatin1String("Image"),
+                                            0, 0, 70, 66);
+    imageLayer->setTransparentColor(QColor(255, 0, 255));
+    imageLayer->loadFromImage(QImage(mImageFileName), mImageFileName);
+    map->addLayer(imageLayer);
+
+    return map;
+}
+
+void test_BinaryMap::roundTrip()
+{
+    Map *map = createMap();
+
+    BinaryMapWriter writer;
+    QVERIFY2(writer.writeMap(map, mMapFileName),
+             qPrintable(writer.errorString()));
+
+    BinaryMapReader reader;
+    Map *read = reader.readMap(mMapFileName);
+    QVERIFY2(read, qPrintable(reader.errorString()));
+
+    QCOMPARE(read->orientation(), map->orientation());
+    QCOMPARE(read->size(), map->size());
+    QCOMPARE(read->tileWidth(), map->tileWidth());
+    QCOMPARE(read->tileHeight(), map->tileHeight());
+    QCOMPARE(read->backgroundColor(), map->backgroundColor());
+    QCOMPARE(read->layerDataFormat(), map->layerDataFormat());
+    QCOMPARE(read->properties(), map->properties());
+
+    // Tilesets
+    QCOMPARE(read->tilesets().size(), 2);
+    const Tileset *embedded = read->tilesets().at(0);
+    const Tileset *external = read->tilesets().at(1);
+    QCOMPARE(embedded->name(), QString(QLatin1String("embedded")));
+    QVERIFY(embedded->fileName().isEmpty());
+    QCOMPARE(embedded->tileCount(), 4);
+    QCOMPARE(external->name(), QString(QLatin1String("external")));
+    QCOMPARE(QFileInfo(external->fileName()).canonicalFilePath(),
+             QFileInfo(mTilesetFileName).canonicalFilePath());
+    QCOMPARE(external->tileCount(), 4);
+
+    QCOMPARE(read->layerCount(), 3);
+
+    // Tile layer
+    const TileLayer *tileLayer = map->layerAt(0)->asTileLayer();
+    const TileLayer *readTileLayer = read->layerAt(0)->asTileLayer();
+    QVERIFY(readTileLayer);
+    QCOMPARE(readTileLayer->name(), tileLayer->name());
+    QCOMPARE(readTileLayer->bounds(), tileLayer->bounds());
+    QCOMPARE(readTileLayer->opacity(), tileLayer->opacity());
+    QCOMPARE(readTileLayer->isVisible(), true);
+    QCOMPARE(readTileLayer->properties(), tileLayer->properties());
+
+    for (int y = 0; y < tileLayer->height(); ++y)
+        for (int x = 0; x < tileLayer->width(); ++x)
+            compareCells(readTileLayer->cellAt(x, y), tileLayer->cellAt(x, y));
+
+    QVERIFY(readTileLayer->cellAt(63, 63).flippedAntiDiagonally());
+
+    // Object group
+    const ObjectGroup *objectGroup = map->layerAt(1)->asObjectGroup();
+    const ObjectGroup *readObjectGroup = read->layerAt(1)->asObjectGroup();
+    QVERIFY(readObjectGroup);
+    QCOMPARE(readObjectGroup->name(), objectGroup->name());
+    QCOMPARE(readObjectGroup->color(), objectGroup->color());
+    QCOMPARE(readObjectGroup->isVisible(), false);
+    QCOMPARE(readObjectGroup->objectCount(), 2);
+
+    for (int i = 0; i < objectGroup->objectCount(); ++i) {
+        const MapObject *object = objectGroup->objects().at(i);
+        const MapObject *readObject = readObjectGroup->objects().at(i);
+        QCOMPARE(readObject->name(), object->name());
+        QCOMPARE(readObject->type(), object->type());
+        QCOMPARE(readObject->position(), object->position());
+        QCOMPARE(readObject->size(), object->size());
+        QCOMPARE(readObject->rotation(), object->rotation());
+        QCOMPARE(readObject->shape(), object->shape());
+        QCOMPARE(readObject->polygon(), object->polygon());
+        QCOMPARE(readObject->properties(), object->properties());
+        compareCells(readObject->cell(), object->cell());
+    }
+
+    // Image layer
+    const ImageLayer *imageLayer = map->layerAt(2)->asImageLayer();
+    const ImageLayer *readImageLayer = read->layerAt(2)->asImageLayer();
+    QVERIFY(readImageLayer);
+    QCOMPARE(readImageLayer->name(), imageLayer->name());
+    QCOMPARE(readImageLayer->transparentColor(),
+             imageLayer->transparentColor());
+    QCOMPARE(QFileInfo(readImageLayer->imageSource()).canonicalFilePath(),
+             QFileInfo(mImageFileName).canonicalFilePath());
+    QVERIFY(!readImageLayer->image().isNull());
+
+    deleteMap(read);
+    delete map->tilesets().first();
+    delete map;
+}
+
+void test_BinaryMap::externalTilesetCache()
+{
+    Map *map = createMap();
+
+    BinaryMapWriter writer;
+    QVERIFY(writer.writeMap(map, mMapFileName));
+
+    TilesetCache cache;
+
+    BinaryMapReader reader1;
+    reader1.setTilesetCache(&cache);
+    Map *map1 = reader1.readMap(mMapFileName);
+    QVERIFY2(map1, qPrintable(reader1.errorString()));
+
+    BinaryMapReader reader2;
+    reader2.setTilesetCache(&cache);
+    Map *map2 = reader2.readMap(mMapFileName);
+    QVERIFY2(map2, qPrintable(reader2.errorString()));
+
+    // Only the external tileset is shared through the cache
+    QVERIFY(map1->tilesets().at(1) == map2->tilesets().at(1));
+    QVERIFY(cache.contains(map1->tilesets().at(1)));
+    QVERIFY(map1->tilesets().at(0) != map2->tilesets().at(0));
+    QVERIFY(!cache.contains(map1->tilesets().at(0)));
+
+    deleteMap(map1, &cache);
+    deleteMap(map2, &cache);
+    delete map->tilesets().first();
+    delete map;
+}
+
+void test_BinaryMap::truncatedMap()
+{
+    Map *map = createMap();
+
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    BinaryMapWriter writer;
+    writer.writeMap(map, &buffer, QDir::tempPath());
+    const QByteArray data = buffer.data();
+
+    delete map->tilesets().first();
+    delete map;
+
+    // Reading the external tileset through a cache keeps this fast
+    TilesetCache cache;
+
+    for (int size = 0; size < data.size(); ++size) {
+        QByteArray truncated = data.left(size);
+        QBuffer truncatedBuffer(&truncated);
+        truncatedBuffer.open(QIODevice::ReadOnly);
+
+        BinaryMapReader reader;
+        reader.setTilesetCache(&cache);
+        Map *read = reader.readMap(&truncatedBuffer, QDir::tempPath());
+        if (read)
+            deleteMap(read, &cache);
+
+        QVERIFY2(!read, qPrintable(QString::number(size)));
+        QVERIFY(!reader.errorString().isEmpty());
+    }
+}
+
+void test_BinaryMap::corruptMap_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QByteArray notBinary = mapHeader();
+    notBinary[0] = 'X';
+    QTest::newRow("magic") << notBinary;
+
+    QByteArray version = mapHeader();
+    version[4] = 2;
+    QTest::newRow("version") << version;
+
+    QTest::newRow("orientation") << mapHeader(Map::Staggered + 1);
+    QTest::newRow("unknown orientation") << mapHeader(Map::Unknown);
+    QTest::newRow("layer data format") << mapHeader(Map::Orthogonal,
+                                                    Map::CSV + 1);
+    QTest::newRow("negative layer data format")
+            << mapHeader(Map::Orthogonal, quint32(-2));
+
+    QByteArray stringCount = mapHeader(Map::Orthogonal, Map::Base64Zlib, 1);
+    stringCount[8] = 100;
+    QTest::newRow("string count") << stringCount;
+
+    QByteArray tilesetKind = mapHeader();
+    appendUInt(tilesetKind, 1);
+    appendUInt(tilesetKind, 2);        // Unknown tileset kind
+    appendUInt(tilesetKind, 1);
+    QTest::newRow("tileset kind") << tilesetKind;
+
+    QByteArray stringIndex = mapHeader();
+    appendUInt(stringIndex, 1);
+    appendUInt(stringIndex, 0);        // External tileset
+    appendUInt(stringIndex, 1);
+    appendUInt(stringIndex, 5);        // No such string
+    QTest::newRow("string index") << stringIndex;
+
+    QByteArray tsx = mapHeader();
+    appendUInt(tsx, 1);
+    appendUInt(tsx, 1);                // Embedded tileset
+    appendUInt(tsx, 1);
+    appendUInt(tsx, 4);
+    tsx.append("<no>");
+    QTest::newRow("embedded tileset") << tsx;
+
+    QByteArray layerKind = mapHeader(Map::Orthogonal, Map::Base64Zlib, 1);
+    appendUInt(layerKind, 0);
+    appendUInt(layerKind, 1);
+    appendLayer(layerKind, 3);
+    QTest::newRow("layer kind") << layerKind;
+
+    QByteArray gids(4 * 4 * 4, '\0');
+    QTest::newRow("chunk outside layer")
+            << tileLayerWithChunk(2, 0, 4, 4, compress(gids, Zlib));
+    QTest::newRow("chunk size")
+            << tileLayerWithChunk(0, 0, 4, 4, compress(gids.left(60), Zlib));
+    QTest::newRow("chunk data")
+            << tileLayerWithChunk(0, 0, 4, 4, QByteArray(16, 'x'));
+
+    gids[0] = 1;
+    QTest::newRow("no tilesets")
+            << tileLayerWithChunk(0, 0, 4, 4, compress(gids, Zlib));
+}
+
+void test_BinaryMap::corruptMap()
+{
+    QFETCH(QByteArray, data);
+
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::ReadOnly);
+
+    BinaryMapReader reader;
+    Map *map = reader.readMap(&buffer);
+    if (map)
+        deleteMap(map);
+
+    QVERIFY(!map);
+    QVERIFY(!reader.errorString().isEmpty());
+}
+
+QTEST_MAIN(test_BinaryMap)
+#include "test_binarymap.moc"
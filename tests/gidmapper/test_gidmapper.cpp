@@ -0,0 +1,155 @@
+#include "gidmapper.h"
+#include "tile.h"
+#include "tileset.h"
+
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+
+class test_GidMapper : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void roundTrip();
+    void lowestFirstGid();
+    void replaceTileset();
+    void replaceTilesetMappedTwice();
+
+    void gidsToCells();
+    void gidsToCellsBadIndex();
+
+private:
+    Tileset *mTileset1;
+    Tileset *mTileset2;
+};
+
+static Tileset *createTileset(const char *name, int tileCount)
+{
+    Tileset *tileset = new Tileset(QLatin1String(name), 16, 16);
+    for (int i = 0; i < tileCount; ++i)
+        tileset->addTile(QPixmap(16, 16));
+    return tileset;
+}
+
+void test_GidMapper::initTestCase()
+{
+    mTileset1 = createTileset("first", 4);
+    mTileset2 = createTileset("second", 8);
+}
+
+void test_GidMapper::cleanupTestCase()
+{
+    delete mTileset1;
+    delete mTileset2;
+}
+
+void test_GidMapper::roundTrip()
+{
+    QList<Tileset*> tilesets;
+    tilesets << mTileset1 << mTileset2;
+    const GidMapper mapper(tilesets);
+
+    Cell cell(mTileset2->tileAt(3));
+    cell.setFlippedHorizontally(true);
+    cell.setFlippedAntiDiagonally(true);
+
+    const unsigned gid = mapper.cellToGid(cell);
+    QCOMPARE(gid, 0xA0000000u | (5 + 3));
+
+    bool ok;
+    QVERIFY(mapper.gidToCell(gid, ok) == cell);
+    QVERIFY(ok);
+
+    QCOMPARE(mapper.cellToGid(Cell()), 0u);
+}
+
+void test_GidMapper::lowestFirstGid()
+{
+    GidMapper mapper;
+    mapper.insert(20, mTileset1);
+    mapper.insert(1, mTileset1);
+
+    QCOMPARE(mapper.cellToGid(Cell(mTileset1->tileAt(2))), 3u);
+}
+
+void test_GidMapper::replaceTileset()
+{
+    GidMapper mapper;
+    mapper.insert(1, mTileset1);
+    mapper.insert(1, mTileset2);
+
+    QCOMPARE(mapper.cellToGid(Cell(mTileset1->tileAt(0))), 0u);
+    QCOMPARE(mapper.cellToGid(Cell(mTileset2->tileAt(0))), 1u);
+}
+
+void test_GidMapper::replaceTilesetMappedTwice()
+{
+    GidMapper mapper;
+    mapper.insert(1, mTileset1);
+    mapper.insert(10, mTileset1);
+
+    // The tileset is still mapped at 10 after being replaced at 1
+    mapper.insert(1, mTileset2);
+
+    QCOMPARE(mapper.cellToGid(Cell(mTileset1->tileAt(1))), 11u);
+    QCOMPARE(mapper.cellToGid(Cell(mTileset2->tileAt(1))), 2u);
+
+    bool ok;
+    QVERIFY(mapper.gidToCell(11, ok).tile() == mTileset1->tileAt(1));
+    QVERIFY(ok);
+}
+
+void test_GidMapper::gidsToCells()
+{
+    QList<Tileset*> tilesets;
+    tilesets << mTileset1 << mTileset2;
+    const GidMapper mapper(tilesets);
+
+    // Switches between tilesets, has empty cells and sets all flip flags
+    const unsigned gids[] = { 0, 1, 2, 5, 12, 4, 0x80000003, 0xE000000C,
+                              0x40000000, 6 };
+    const int count = sizeof(gids) / sizeof(gids[0]);
+    Cell cells[count];
+
+    QCOMPARE(mapper.gidsToCells(gids, count, cells), -1);
+
+    for (int i = 0; i < count; ++i) {
+        bool ok;
+        const Cell expected = mapper.gidToCell(gids[i], ok);
+        QVERIFY(ok);
+        QVERIFY(cells[i] == expected);
+    }
+
+    QVERIFY(cells[0].isEmpty());
+    QVERIFY(cells[4].tile() == mTileset2->tileAt(7));
+    QVERIFY(cells[7].tile() == mTileset2->tileAt(7));
+    QCOMPARE(cells[7].flipFlags(), unsigned(Cell::FlipMask));
+    QVERIFY(cells[8].isEmpty());
+    QVERIFY(cells[8].flippedVertically());
+}
+
+void test_GidMapper::gidsToCellsBadIndex()
+{
+    GidMapper mapper;
+    mapper.insert(10, mTileset1);
+
+    // Gids below the first first GID are not covered by any tileset
+    const unsigned gids[] = { 0, 10, 13, 9, 3 };
+    const int count = sizeof(gids) / sizeof(gids[0]);
+    Cell cells[count];
+
+    QCOMPARE(mapper.gidsToCells(gids, count, cells), 3);
+    QVERIFY(cells[1].tile() == mTileset1->tileAt(0));
+    QVERIFY(cells[2].tile() == mTileset1->tileAt(3));
+
+    // Any gid is bad when there are no tilesets
+    GidMapper empty;
+    QCOMPARE(empty.gidsToCells(gids, count, cells), 1);
+}
+
+QTEST_MAIN(test_GidMapper)
+#include "test_gidmapper.moc"
@@ -1,9 +1,13 @@
+#include "compression.h"
+#include "gidmapper.h"
 #include "map.h"
 #include "mapobject.h"
 #include "objectgroup.h"
 #include "tilelayer.h"
 #include "mapreader.h"
+#include "mapwriter.h"
 
+#include <QtEndian>
 #include <QtTest/QtTest>
 
 using namespace Tiled;
@@ -13,9 +17,43 @@ class test_MapReader : public QObject
     Q_OBJECT
 
 private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
     void loadMap();
+
+    void csvLayerData_data();
+    void csvLayerData();
+    void csvRoundTrip();
+    void layerDataAfterEmbeddedImage();
+
+    void zlibLayerData_data();
+    void zlibLayerData();
+
+private:
+    Map *readCsvMap(const QByteArray &data, QString *error = 0);
+    Map *readLayerDataMap(const QByteArray &attributes,
+                          const QByteArray &data, QString *error);
+
+    QString mImageFileName;
 };
 
+void test_MapReader::initTestCase()
+{
+    // A tileset image with two 16x16 tiles, used by the CSV tests
+    mImageFileName = QDir::tempPath() +
+            QLatin1String("/test_mapreader_tiles.png");
+
+    QImage image(32, 16, QImage::Format_ARGB32);
+    image.fill(0);
+    QVERIFY(image.save(mImageFileName));
+}
+
+void test_MapReader::cleanupTestCase()
+{
+    QFile::remove(mImageFileName);
+}
+
 void test_MapReader::loadMap()
 {
     MapReader reader;
@@ -53,5 +91,267 @@ void test_MapReader::loadMap()
     QCOMPARE(mapObject->height(), qreal(64) / qreal(map->tileHeight()));
 }
 
+/**
+ * Reads a 2x2 map with a single tile layer, using the given CSV \a data.
+ */
+Map *test_MapReader::readCsvMap(const QByteArray &data, QString *error)
+{
+    return readLayerDataMap("encoding=\"csv\"", data, error);
+}
+
+/**
+ * Reads a 2x2 map with a single tile layer, using the given layer \a data
+ * with the given \a attributes on its data element.
+ */
+Map *test_MapReader::readLayerDataMap(const QByteArray &attributes,
+                                      const QByteArray &data, QString *error)
+{
+    const QByteArray imageSource = QFileInfo(mImageFileName).fileName().toUtf8();
+
+    QByteArray xml =
+            "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<map version=\"1.0\" orientation=\"orthogonal\""
+            " width=\"2\" height=\"2\" tilewidth=\"16\" tileheight=\"16\">\n"
+            " <tileset firstgid=\"1\" name=\"tiles\""
+            " tilewidth=\"16\" tileheight=\"16\">\n"
+            "  <image source=\"" + imageSource + "\" width=\"32\" height=\"16\"/>\n"
+            " </tileset>\n"
+            " <layer name=\"layer\" width=\"2\" height=\"2\">\n"
+            "  <data " + attributes + ">" + data + "</data>\n"
+            " </layer>\n"
+            "</map>\n";
+
+    QBuffer buffer(&xml);
+    buffer.open(QIODevice::ReadOnly);
+
+    MapReader reader;
+    Map *map = reader.readMap(&buffer, QDir::tempPath());
+    if (error)
+        *error = reader.errorString();
+    return map;
+}
+
+/**
+ * Returns the gids of the tile layer at \a layerIndex of the \a map,
+ * separated by commas.
+ */
+static QString layerGids(const Map *map, int layerIndex = 0)
+{
+    const GidMapper gidMapper(map->tilesets());
+    const TileLayer *tileLayer = map->layerAt(layerIndex)->asTileLayer();
+
+    QStringList gids;
+    for (int y = 0; y < tileLayer->height(); ++y)
+        for (int x = 0; x < tileLayer->width(); ++x)
+            gids.append(QString::number(gidMapper.cellToGid(tileLayer->cellAt(x, y))));
+
+    return gids.join(QLatin1String(","));
+}
+
+void test_MapReader::csvLayerData_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<QString>("gids");   // empty when reading should fail
+
+    QTest::newRow("plain")
+            << QByteArray("1,2,0,2")
+            << QString(QLatin1String("1,2,0,2"));
+    QTest::newRow("whitespace")
+            << QByteArray("\n  1, 2 ,\n\t0,\r\n2\n  ")
+            << QString(QLatin1String("1,2,0,2"));
+    QTest::newRow("flipped")
+            << QByteArray("3758096385,2147483650,\n1073741825,536870914\n")
+            << QString(QLatin1String("3758096385,2147483650,"
+                                     "1073741825,536870914"));
+    QTest::newRow("trailing comma")
+            << QByteArray("1,2,0,2,")
+            << QString();
+    QTest::newRow("too few")
+            << QByteArray("1,2,0")
+            << QString();
+    QTest::newRow("too many")
+            << QByteArray("1,2,0,2,1")
+            << QString();
+    // Without any data, the layer is left empty like with XML encoding
+    QTest::newRow("empty")
+            << QByteArray("")
+            << QString(QLatin1String("0,0,0,0"));
+    QTest::newRow("empty value")
+            << QByteArray("1,,0,2")
+            << QString();
+    QTest::newRow("not a number")
+            << QByteArray("1,2,x,2")
+            << QString();
+    QTest::newRow("missing comma")
+            << QByteArray("1,2 0,2")
+            << QString();
+    QTest::newRow("negative")
+            << QByteArray("1,2,-1,2")
+            << QString();
+    QTest::newRow("overflow")
+            << QByteArray("1,2,0,4294967296")
+            << QString();
+    QTest::newRow("large overflow")
+            << QByteArray("1,2,0,99999999999")
+            << QString();
+}
+
+void test_MapReader::csvLayerData()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(QString, gids);
+
+    QString error;
+    Map *map = readCsvMap(data, &error);
+
+    if (gids.isEmpty()) {
+        QVERIFY(!map);
+        QVERIFY(!error.isEmpty());
+        return;
+    }
+
+    QVERIFY2(map, qPrintable(error));
+    QCOMPARE(layerGids(map), gids);
+
+    qDeleteAll(map->tilesets());
+    delete map;
+}
+
+void test_MapReader::csvRoundTrip()
+{
+    const QString gids(QLatin1String("3758096385,0,1073741825,2"));
+    Map *map = readCsvMap(gids.toLatin1());
+    QVERIFY(map);
+
+    QByteArray written;
+    QBuffer buffer(&written);
+    buffer.open(QIODevice::WriteOnly);
+
+    MapWriter writer;
+    writer.setLayerDataFormat(Map::CSV);
+    writer.writeMap(map, &buffer, QDir::tempPath());
+    buffer.close();
+
+    // The rows are separated by newlines, with a comma after all but the
+    // last value
+    QVERIFY(written.contains("<data encoding=\"csv\">\n"
+                             "3758096385,0,\n"
+                             "1073741825,2\n"
+                             "</data>"));
+
+    QString error;
+    const QByteArray dataStart("<data encoding=\"csv\">");
+    const int start = written.indexOf(dataStart) + dataStart.size();
+    const int end = written.indexOf("</data>");
+    Map *readBack = readCsvMap(written.mid(start, end - start), &error);
+    QVERIFY2(readBack, qPrintable(error));
+    QCOMPARE(layerGids(readBack), gids);
+
+    qDeleteAll(map->tilesets());
+    delete map;
+    qDeleteAll(readBack->tilesets());
+    delete readBack;
+}
+
+void test_MapReader::layerDataAfterEmbeddedImage()
+{
+    QImage image(32, 16, QImage::Format_ARGB32);
+    image.fill(0);
+
+    QByteArray png;
+    QBuffer pngBuffer(&png);
+    pngBuffer.open(QIODevice::WriteOnly);
+    QVERIFY(image.save(&pngBuffer, "png"));
+
+    // The <data> elements of the embedded image and of the XML encoded
+    // layer are not layer data, and the non-ASCII layer name makes the
+    // byte offsets in the file differ from the character offsets
+    QTemporaryFile mapFile(QDir::tempPath() + QLatin1String("/XXXXXX.tmx"));
+    QVERIFY(mapFile.open());
+    mapFile.write("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                  "<map version=\"1.0\" orientation=\"orthogonal\""
+                  " width=\"2\" height=\"2\" tilewidth=\"16\""
+                  " tileheight=\"16\">\n"
+                  " <tileset firstgid=\"1\" name=\"tiles\""
+                  " tilewidth=\"16\" tileheight=\"16\">\n"
+                  "  <image format=\"png\" width=\"32\" height=\"16\">\n"
+                  "   <data encoding=\"base64\">");
+    mapFile.write(png.toBase64());
+    mapFile.write("</data>\n"
+                  "  </image>\n"
+                  " </tileset>\n"
+                  " <layer name=\"\xc3\xa9\xc3\xa9\" width=\"2\" height=\"2\">\n"
+                  "  <data>\n"
+                  "   <tile gid=\"2\"/><tile gid=\"1\"/>"
+                  "<tile gid=\"0\"/><tile gid=\"0\"/>\n"
+                  "  </data>\n"
+                  " </layer>\n"
+                  " <layer name=\"csv\" width=\"2\" height=\"2\">\n"
+                  "  <data encoding=\"csv\">1,2,0,2</data>\n"
+                  " </layer>\n"
+                  "</map>\n");
+    mapFile.close();
+
+    MapReader reader;
+    Map *map = reader.readMap(mapFile.fileName());
+    QVERIFY2(map, qPrintable(reader.errorString()));
+    QCOMPARE(map->layerCount(), 2);
+    QCOMPARE(layerGids(map, 0), QString(QLatin1String("2,1,0,0")));
+    QCOMPARE(layerGids(map, 1), QString(QLatin1String("1,2,0,2")));
+
+    qDeleteAll(map->tilesets());
+    delete map;
+}
+
+void test_MapReader::zlibLayerData_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<QString>("gids");   // empty when reading should fail
+
+    QByteArray gids;
+    const uchar values[] = { 1, 2, 0, 2 };
+    for (int i = 0; i < 4; ++i) {
+        uchar bytes[4];
+        qToLittleEndian<quint32>(values[i], bytes);
+        gids.append(reinterpret_cast<const char*>(bytes), 4);
+    }
+    const QByteArray compressed = compress(gids, Zlib);
+
+    QTest::newRow("plain")
+            << compressed.toBase64()
+            << QString(QLatin1String("1,2,0,2"));
+    QTest::newRow("whitespace")
+            << QByteArray("\n   " + compressed.toBase64() + "\n  ")
+            << QString(QLatin1String("1,2,0,2"));
+    QTest::newRow("trailing data")
+            << QByteArray(compressed + "junk").toBase64()
+            << QString();
+    QTest::newRow("truncated")
+            << compressed.left(compressed.size() - 4).toBase64()
+            << QString();
+}
+
+void test_MapReader::zlibLayerData()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(QString, gids);
+
+    QString error;
+    Map *map = readLayerDataMap("encoding=\"base64\" compression=\"zlib\"",
+                                data, &error);
+
+    if (gids.isEmpty()) {
+        QVERIFY(!map);
+        QVERIFY(!error.isEmpty());
+        return;
+    }
+
+    QVERIFY2(map, qPrintable(error));
+    QCOMPARE(layerGids(map), gids);
+
+    qDeleteAll(map->tilesets());
+    delete map;
+}
+
 QTEST_MAIN(test_MapReader)
 #include "test_mapreader.moc"
@@ -1,4 +1,8 @@
 TEMPLATE=subdirs
 SUBDIRS = \
+    binarymap \
+    gidmapper \
     mapreader \
-    staggeredrenderer
+    staggeredrenderer \
+    tilelayer \
+    tilesetcache
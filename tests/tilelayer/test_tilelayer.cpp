@@ -0,0 +1,160 @@
+#include "tile.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+
+class test_TileLayer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void packedCell();
+
+    void storage_data();
+    void storage();
+
+    void chunkedStorage();
+    void setStorage();
+
+private:
+    Tileset *mTileset;
+};
+
+void test_TileLayer::initTestCase()
+{
+    mTileset = new Tileset(QLatin1String("tiles"), 16, 16);
+    for (int i = 0; i < 4; ++i)
+        mTileset->addTile(QPixmap(16, 16));
+}
+
+void test_TileLayer::cleanupTestCase()
+{
+    delete mTileset;
+}
+
+void test_TileLayer::packedCell()
+{
+    QVERIFY(sizeof(Cell) == sizeof(void*));
+
+    Tile *tile = mTileset->tileAt(2);
+    Cell cell(tile);
+    cell.setFlippedVertically(true);
+    cell.setFlippedAntiDiagonally(true);
+
+    QVERIFY(cell.tile() == tile);
+    QVERIFY(!cell.flippedHorizontally());
+    QVERIFY(cell.flippedVertically());
+    QVERIFY(cell.flippedAntiDiagonally());
+    QCOMPARE(cell.flipFlags(), unsigned(Cell::FlippedVertically |
+                                        Cell::FlippedAntiDiagonally));
+
+    Cell other(tile);
+    QVERIFY(cell != other);
+    other.setFlipFlags(cell.flipFlags());
+    QVERIFY(cell == other);
+
+    cell.setTile(mTileset->tileAt(3));
+    QVERIFY(cell.tile() == mTileset->tileAt(3));
+    QVERIFY(cell.flippedVertically());
+}
+
+void test_TileLayer::storage_data()
+{
+    QTest::addColumn<int>("storage");
+
+    QTest::newRow("dense") << int(TileLayer::DenseStorage);
+    QTest::newRow("chunked") << int(TileLayer::ChunkedStorage);
+}
+
+/**
+ * Performs the same operations on layers using either kind of storage, and
+ * checks that they lead to the same results.
+ */
+void test_TileLayer::storage()
+{
+    QFETCH(int, storage);
+
+    TileLayer layer(QString(), 0, 0, 70, 40);
+    layer.setStorage(TileLayer::Storage(storage));
+    QCOMPARE(int(layer.storage()), storage);
+    QVERIFY(layer.isEmpty());
+
+    Cell cell(mTileset->tileAt(1));
+    cell.setFlippedHorizontally(true);
+    layer.setCell(2, 3, cell);
+    layer.setCell(69, 39, Cell(mTileset->tileAt(2)));
+
+    QVERIFY(!layer.isEmpty());
+    QCOMPARE(layer.region(), QRegion(2, 3, 1, 1) + QRegion(69, 39, 1, 1));
+    QCOMPARE(layer.usedTilesets().size(), 1);
+    QVERIFY(layer.referencesTileset(mTileset));
+
+    layer.flip(FlipHorizontally);
+    QVERIFY(layer.cellAt(67, 3).tile() == mTileset->tileAt(1));
+    QVERIFY(!layer.cellAt(67, 3).flippedHorizontally());
+    QVERIFY(layer.cellAt(0, 39).tile() == mTileset->tileAt(2));
+
+    layer.rotate(RotateRight);
+    QCOMPARE(layer.width(), 40);
+    QCOMPARE(layer.height(), 70);
+    QVERIFY(layer.cellAt(36, 67).tile() == mTileset->tileAt(1));
+    QVERIFY(layer.cellAt(0, 0).tile() == mTileset->tileAt(2));
+
+    layer.resize(QSize(50, 80), QPoint(5, 5));
+    QVERIFY(layer.cellAt(41, 72).tile() == mTileset->tileAt(1));
+    QVERIFY(layer.cellAt(5, 5).tile() == mTileset->tileAt(2));
+
+    layer.offset(QPoint(-10, 0), QRect(0, 0, 50, 80), true, false);
+    QVERIFY(layer.cellAt(31, 72).tile() == mTileset->tileAt(1));
+    QVERIFY(layer.cellAt(45, 5).tile() == mTileset->tileAt(2));
+
+    TileLayer *copy = layer.copy(QRegion(30, 70, 5, 5));
+    QCOMPARE(copy->region(), QRegion(1, 2, 1, 1));
+
+    TileLayer *clone = static_cast<TileLayer*>(layer.clone());
+    QVERIFY(clone->computeDiffRegion(&layer).isEmpty());
+    clone->merge(QPoint(0, 0), copy);
+    QCOMPARE(clone->computeDiffRegion(&layer), QRegion(1, 2, 1, 1));
+
+    layer.removeReferencesToTileset(mTileset);
+    QVERIFY(layer.isEmpty());
+
+    delete clone;
+    delete copy;
+}
+
+void test_TileLayer::chunkedStorage()
+{
+    TileLayer layer(QString(), 0, 0, 4096, 4096);
+    QCOMPARE(layer.storage(), TileLayer::ChunkedStorage);
+
+    // Writing empty cells should not change anything
+    layer.erase(QRegion(0, 0, 4096, 4096));
+    QVERIFY(layer.isEmpty());
+
+    layer.setCell(4095, 4095, Cell(mTileset->tileAt(3)));
+    QCOMPARE(layer.region(), QRegion(4095, 4095, 1, 1));
+    QVERIFY(layer.cellAt(0, 0).isEmpty());
+}
+
+void test_TileLayer::setStorage()
+{
+    TileLayer layer(QString(), 0, 0, 100, 100);
+    QCOMPARE(layer.storage(), TileLayer::DenseStorage);
+
+    layer.setCell(50, 50, Cell(mTileset->tileAt(0)));
+    layer.setStorage(TileLayer::ChunkedStorage);
+    QCOMPARE(layer.region(), QRegion(50, 50, 1, 1));
+
+    layer.setStorage(TileLayer::DenseStorage);
+    QCOMPARE(layer.region(), QRegion(50, 50, 1, 1));
+}
+
+QTEST_MAIN(test_TileLayer)
+#include "test_tilelayer.moc"
@@ -0,0 +1,193 @@
+#include "map.h"
+#include "mapreader.h"
+#include "tileset.h"
+#include "tilesetcache.h"
+
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+
+class test_TilesetCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void cachedTileset();
+    void modifiedTileset();
+    void missingTileset();
+    void sharedByMapReaders();
+    void concurrentRequests();
+
+private:
+    QTemporaryFile *mTilesetFile;
+    QString mFileName;
+};
+
+static bool writeTileset(const QString &fileName, const char *name)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    file.write("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+               "<tileset name=\"");
+    file.write(name);
+    file.write("\" tilewidth=\"16\" tileheight=\"16\">\n"
+               "</tileset>\n");
+    return true;
+}
+
+void test_TilesetCache::init()
+{
+    mTilesetFile = new QTemporaryFile(QDir::tempPath() +
+                                      QLatin1String("/XXXXXX.tsx"));
+    QVERIFY(mTilesetFile->open());
+    mFileName = mTilesetFile->fileName();
+    mTilesetFile->close();
+
+    QVERIFY(writeTileset(mFileName, "first"));
+}
+
+void test_TilesetCache::cleanup()
+{
+    delete mTilesetFile;
+    mTilesetFile = 0;
+}
+
+void test_TilesetCache::cachedTileset()
+{
+    TilesetCache cache;
+
+    Tileset *tileset = cache.tileset(mFileName);
+    QVERIFY(tileset);
+    QCOMPARE(tileset->name(), QString(QLatin1String("first")));
+    QVERIFY(cache.contains(tileset));
+
+    QVERIFY(cache.tileset(mFileName) == tileset);
+}
+
+void test_TilesetCache::modifiedTileset()
+{
+    TilesetCache cache;
+
+    Tileset *tileset = cache.tileset(mFileName);
+    QVERIFY(tileset);
+
+    // Rewrite the file until its modification time changes, since the
+    // resolution of the time stamp depends on the file system
+    const QDateTime lastModified = QFileInfo(mFileName).lastModified();
+    for (int i = 0; i < 30; ++i) {
+        QTest::qSleep(100);
+        QVERIFY(writeTileset(mFileName, "second"));
+        if (QFileInfo(mFileName).lastModified() != lastModified)
+            break;
+    }
+    QVERIFY(QFileInfo(mFileName).lastModified() != lastModified);
+
+    Tileset *modified = cache.tileset(mFileName);
+    QVERIFY(modified);
+    QVERIFY(modified != tileset);
+    QCOMPARE(modified->name(), QString(QLatin1String("second")));
+
+    // The replaced tileset may still be in use, so it stays owned
+    QVERIFY(cache.contains(tileset));
+    QVERIFY(cache.contains(modified));
+    QVERIFY(cache.tileset(mFileName) == modified);
+}
+
+void test_TilesetCache::missingTileset()
+{
+    TilesetCache cache;
+    QString error;
+
+    QVERIFY(!cache.tileset(mFileName + QLatin1String(".missing"), &error));
+    QVERIFY(!error.isEmpty());
+}
+
+void test_TilesetCache::sharedByMapReaders()
+{
+    QTemporaryFile mapFile(QDir::tempPath() + QLatin1String("/XXXXXX.tmx"));
+    QVERIFY(mapFile.open());
+
+    const QString source = QFileInfo(mFileName).fileName();
+    mapFile.write("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                  "<map version=\"1.0\" orientation=\"orthogonal\""
+                  " width=\"2\" height=\"2\" tilewidth=\"16\""
+                  " tileheight=\"16\">\n"
+                  " <tileset firstgid=\"1\" source=\"");
+    mapFile.write(source.toUtf8());
+    mapFile.write("\"/>\n"
+                  "</map>\n");
+    mapFile.close();
+
+    TilesetCache cache;
+
+    MapReader reader1;
+    reader1.setTilesetCache(&cache);
+    Map *map1 = reader1.readMap(mapFile.fileName());
+    QVERIFY(map1);
+
+    MapReader reader2;
+    reader2.setTilesetCache(&cache);
+    Map *map2 = reader2.readMap(mapFile.fileName());
+    QVERIFY(map2);
+
+    QCOMPARE(map1->tilesets().size(), 1);
+    QVERIFY(map1->tilesets().first() == map2->tilesets().first());
+    QVERIFY(cache.contains(map1->tilesets().first()));
+
+    // The tilesets are owned by the cache
+    delete map1;
+    delete map2;
+}
+
+namespace {
+
+class TilesetRequester : public QThread
+{
+public:
+    TilesetRequester(TilesetCache *cache, const QString &fileName)
+        : mCache(cache)
+        , mFileName(fileName)
+        , mTileset(0)
+    {}
+
+    Tileset *tileset() const { return mTileset; }
+
+protected:
+    void run() { mTileset = mCache->tileset(mFileName); }
+
+private:
+    TilesetCache *mCache;
+    QString mFileName;
+    Tileset *mTileset;
+};
+
+} // anonymous namespace
+
+void test_TilesetCache::concurrentRequests()
+{
+    TilesetCache cache;
+    QList<TilesetRequester*> requesters;
+
+    for (int i = 0; i < 8; ++i)
+        requesters.append(new TilesetRequester(&cache, mFileName));
+    foreach (TilesetRequester *requester, requesters)
+        requester->start();
+    foreach (TilesetRequester *requester, requesters)
+        requester->wait();
+
+    // All threads get the same tileset, since it is read only once
+    Tileset *tileset = requesters.first()->tileset();
+    QVERIFY(tileset);
+    foreach (TilesetRequester *requester, requesters)
+        QVERIFY(requester->tileset() == tileset);
+
+    qDeleteAll(requesters);
+}
+
+QTEST_MAIN(test_TilesetCache)
+#include "test_tilesetcache.moc"